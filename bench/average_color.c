@@ -0,0 +1,151 @@
+// Micro-benchmark of `image_average_color()`
+//
+// Compares the current implementation with the original scalar float
+// routine on a large synthetic artwork (or on the image passed as the first
+// argument).
+//
+// Usage:
+//     RELEASE=1 make bench
+//     ./build/bench_average_color [image]
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <raylib.h>
+
+#include "../src/utils.h"
+#include "../src/macros.h"
+
+#define SYNTHETIC_SIZE 3000
+#define ITERATIONS 20
+
+// `image_average_color()` as it was before vectorization
+static Color _reference_average_color(Image image) {
+	unsigned char *data = image.data;
+	float cr = 0.0, cg = 0.0, cb = 0.0;
+	float n = 1.0;
+	for (int i = 0; i < image.width * image.height * 4; i += 4) {
+		int r = data[i + 0];
+		int g = data[i + 1];
+		int b = data[i + 2];
+		float max = (float)MAX(r, MAX(g, b));
+		float min = (float)MIN(r, MIN(g, b));
+		float saturation = 0.0;
+		float lightness = (max + min) / 2.0 / 255.0;
+		if (max > 0) saturation = (max - min) / max;
+
+		if (saturation >= 0.5 && lightness > 0.3) {
+			n += 1.0;
+			cr += r;
+			cg += g;
+			cb += b;
+		}
+		if (lightness >= 0.6) {
+			n += 0.2;
+			cr += r/5;
+			cg += g/5;
+			cb += b/5;
+		}
+	}
+
+	Color color = {
+		(char)MAX(cr/n, 50.0),
+		(char)MAX(cg/n, 50.0),
+		(char)MAX(cb/n, 50.0),
+		255
+	};
+	return ColorBrightness(color, 0.4);
+}
+
+static double _now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Smooth gradients with some noise, roughly how album covers look like
+static Image _synthetic_artwork(int size) {
+	unsigned char *data = malloc((size_t)size * size * 4);
+	srand(42);
+
+	for (int y = 0; y < size; y++) {
+		for (int x = 0; x < size; x++) {
+			unsigned char *p = &data[((size_t)y * size + x) * 4];
+			p[0] = (unsigned char)(x * 255 / size + rand() % 16);
+			p[1] = (unsigned char)(y * 255 / size + rand() % 16);
+			p[2] = (unsigned char)((x + y) * 127 / size + rand() % 16);
+			p[3] = 255;
+		}
+	}
+
+	return (Image){
+		.data = data,
+		.width = size,
+		.height = size,
+		.mipmaps = 1,
+		.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8,
+	};
+}
+
+typedef Color (*AverageColorFunc)(Image image, int row_step);
+
+static Color _reference(Image image, int row_step) {
+	(void)row_step;
+	return _reference_average_color(image);
+}
+
+static void _bench(const char *name, AverageColorFunc func, Image image, int row_step) {
+	// Warm up caches
+	Color color = func(image, row_step);
+
+	double start = _now_ms();
+	for (int i = 0; i < ITERATIONS; i++)
+		color = func(image, row_step);
+	double elapsed = (_now_ms() - start) / ITERATIONS;
+
+	double mpixels = (double)image.width * image.height / 1000000.0;
+	printf(
+		"%-24s %8.3f ms  %8.1f Mpx/s  color: %3d %3d %3d\n",
+		name,
+		elapsed,
+		mpixels / (elapsed / 1000.0),
+		color.r, color.g, color.b
+	);
+}
+
+int main(int argc, char **argv) {
+	SetTraceLogLevel(LOG_WARNING);
+
+	Image image;
+	if (argc > 1) {
+		image = LoadImage(argv[1]);
+		if (image.data == NULL) {
+			fprintf(stderr, "Unable to load %s\n", argv[1]);
+			return 1;
+		}
+		ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+	} else {
+		image = _synthetic_artwork(SYNTHETIC_SIZE);
+	}
+
+#if defined(__AVX2__)
+	const char *simd = "AVX2";
+#elif defined(__SSE2__)
+	const char *simd = "SSE2";
+#else
+	const char *simd = "none";
+#endif
+
+	printf("Image: %dx%d, SIMD: %s, %d iterations\n", image.width, image.height, simd, ITERATIONS);
+
+	_bench("reference (float)", _reference, image, 1);
+	_bench("vectorized", image_average_color_sampled, image, 1);
+	_bench("vectorized, 1/2 rows", image_average_color_sampled, image, 2);
+	_bench("vectorized, 1/4 rows", image_average_color_sampled, image, 4);
+
+	UnloadImage(image);
+	return 0;
+}
@@ -0,0 +1,223 @@
+// End-to-end benchmark of the client thread against a scripted fake MPD
+// server (see `fake_mpd.h`), no real MPD or music library is needed
+//
+// Reports:
+// - time until the whole queue is received by the UI
+// - time until the albums list is received by the UI
+// - artwork throughput (download + decode) for distinct albums
+// - round trip latency of the play/pause action until the new status is
+//   visible to the UI
+//
+// Usage:
+//     RELEASE=1 make bench
+//     ./build/bench_client [--songs N] [--albums N] [--latency MS]
+//                          [--artworks N] [--actions N] [--cover PX]
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <raylib.h>
+
+#include "../src/client.h"
+#include "../src/artwork_cache.h"
+#include "../src/utils.h"
+#include "../src/trace.h"
+#include "./fake_mpd.h"
+
+// Give up if the client doesn't respond for this long
+#define STEP_TIMEOUT_MS 120000
+
+typedef struct Bench {
+	Client *client;
+	double start_ms;
+
+	double queue_loaded_ms;
+	unsigned queue_len;
+
+	double albums_loaded_ms;
+	EventDataAlbumsList albums;
+
+	int responses;
+} Bench;
+
+static void _sleep_ms(double ms) {
+	long ns = (long)(ms * 1000000.0);
+	struct timespec ts = { .tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000 };
+	nanosleep(&ts, NULL);
+}
+
+static int _compare_doubles(const void *a, const void *b) {
+	double x = *(const double*)a;
+	double y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+// Handle the events like the UI would
+static void _bench_drain_events(Bench *b) {
+	Event events[EVENTS_QUEUE_CAP];
+	size_t len;
+	while ((len = client_pop_events(b->client, events, EVENTS_QUEUE_CAP)) > 0) {
+		for (size_t i = 0; i < len; i++) {
+			Event event = events[i];
+			double now = monotonic_ms() - b->start_ms;
+
+			switch (event.kind) {
+				case EVENT_QUEUE_CHANGED:
+					b->queue_len = event.data.queue.queue_len;
+					if (b->queue_loaded_ms == 0) b->queue_loaded_ms = now;
+					break;
+				case EVENT_ALBUMS_LIST_CHANGED:
+					if (b->albums_loaded_ms == 0) {
+						b->albums_loaded_ms = now;
+						// Keep the list to request the artworks
+						b->albums = event.data.albums;
+						continue;
+					}
+					break;
+				case EVENT_RESPONSE:
+					b->responses += 1;
+					break;
+				default:
+					break;
+			}
+
+			event_free(event);
+		}
+	}
+}
+
+static bool _bench_wait(Bench *b, bool (*done)(Bench *b), const char *what) {
+	double deadline = monotonic_ms() + STEP_TIMEOUT_MS;
+	while (!done(b)) {
+		if (monotonic_ms() > deadline) {
+			fprintf(stderr, "ERROR: Timed out waiting for %s\n", what);
+			return false;
+		}
+		_sleep_ms(0.2);
+		_bench_drain_events(b);
+	}
+	return true;
+}
+
+static bool _lists_loaded(Bench *b) {
+	return b->queue_loaded_ms > 0 && b->albums_loaded_ms > 0;
+}
+
+static int artworks_target = 0;
+static bool _artworks_received(Bench *b) {
+	return b->responses >= artworks_target;
+}
+
+static enum mpd_state _bench_player_state(Bench *b) {
+	const struct mpd_status *status;
+	client_lock_status_nullable(b->client, NULL, &status);
+	enum mpd_state state = status ? mpd_status_get_state(status) : MPD_STATE_UNKNOWN;
+	client_unlock_status(b->client);
+	return state;
+}
+
+static enum mpd_state prev_state = MPD_STATE_UNKNOWN;
+static bool _state_changed(Bench *b) {
+	return _bench_player_state(b) != prev_state;
+}
+
+static int _arg_int(int argc, char **argv, const char *name, int fallback) {
+	for (int i = 1; i + 1 < argc; i++) {
+		if (strcmp(argv[i], name) == 0) return atoi(argv[i + 1]);
+	}
+	return fallback;
+}
+
+int main(int argc, char **argv) {
+	SetTraceLogLevel(LOG_WARNING);
+
+	FakeMpdConfig config = FAKE_MPD_DEFAULT_CONFIG;
+	config.songs = _arg_int(argc, argv, "--songs", config.songs);
+	config.albums = _arg_int(argc, argv, "--albums", config.albums);
+	config.latency_ms = _arg_int(argc, argv, "--latency", config.latency_ms);
+	config.cover_size = _arg_int(argc, argv, "--cover", config.cover_size);
+	int artworks = _arg_int(argc, argv, "--artworks", 200);
+	int actions = _arg_int(argc, argv, "--actions", 100);
+
+	int port = fake_mpd_start(config);
+
+	// Connect to the fake server and don't touch the real artworks cache
+	char port_str[16];
+	snprintf(port_str, sizeof(port_str), "%d", port);
+	setenv("MPD_HOST", "127.0.0.1", 1);
+	setenv("MPD_PORT", port_str, 1);
+	unsetenv("MPD_PASSWORD");
+	unsetenv("XDG_CACHE_HOME");
+	unsetenv("HOME");
+
+	Client client = client_new();
+	Bench b = { .client = &client };
+
+	b.start_ms = monotonic_ms();
+	client_connect(&client);
+
+	int status = 1;
+
+	if (!_bench_wait(&b, _lists_loaded, "the queue and albums list")) goto defer;
+	if (b.queue_len != (unsigned)config.songs) {
+		fprintf(stderr, "ERROR: Expected %d songs in the queue, got %u\n", config.songs, b.queue_len);
+		goto defer;
+	}
+
+	// Artworks
+	artworks = MIN(artworks, (int)b.albums.len);
+	double artworks_start = monotonic_ms();
+	for (int i = 0; i < artworks; i++) {
+		AlbumInfo *info = &b.albums.items[i];
+		if (!info->first_song_uri_nullable) continue;
+
+		uint64_t key = artwork_key(info->title, info->artist_nullable, info->first_song_uri_nullable);
+		client_request(&client, key, 128, info->first_song_uri_nullable, REQUEST_PRIORITY_VISIBLE);
+		artworks_target += 1;
+	}
+	if (!_bench_wait(&b, _artworks_received, "the artworks")) goto defer;
+	double artworks_time = monotonic_ms() - artworks_start;
+
+	// Actions
+	double *latencies = malloc(sizeof(double) * MAX(actions, 1));
+	for (int i = 0; i < actions; i++) {
+		prev_state = _bench_player_state(&b);
+
+		double action_start = monotonic_ms();
+		client_push_action_kind(&client, ACTION_TOGGLE);
+		if (!_bench_wait(&b, _state_changed, "the status to change")) {
+			free(latencies);
+			goto defer;
+		}
+		latencies[i] = monotonic_ms() - action_start;
+	}
+	qsort(latencies, actions, sizeof(double), _compare_doubles);
+
+	printf("songs:    %d in %d albums, %dms latency\n", config.songs, config.albums, config.latency_ms);
+	printf("queue:    %10.2f ms\n", b.queue_loaded_ms);
+	printf("albums:   %10.2f ms\n", b.albums_loaded_ms);
+	printf("artworks: %10.2f ms for %d (%.1f/s)\n",
+		artworks_time, artworks_target, artworks_target * 1000.0 / artworks_time);
+	if (actions > 0) {
+		printf("actions:  %10.2f ms p50, %.2f ms p90, %.2f ms max\n",
+			latencies[actions / 2], latencies[actions * 9 / 10], latencies[actions - 1]);
+	}
+	free(latencies);
+
+	status = 0;
+
+defer:
+	client_push_action_kind(&client, ACTION_CLOSE);
+	client_wait_for_thread(&client);
+
+	for (size_t i = 0; i < b.albums.len; i++)
+		album_info_free(b.albums.items[i]);
+	free(b.albums.items);
+
+	trace_dump();
+	return status;
+}
@@ -0,0 +1,585 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <raylib.h>
+
+#include "./fake_mpd.h"
+#include "../src/utils.h"
+#include "../src/macros.h"
+
+#define LINE_CAP 4096
+#define MAX_ARGS 16
+// Max number of commands in a command list
+#define MAX_LIST_LEN 4096
+#define ALBUMS_PER_ARTIST 4
+
+// Error codes of the ACK responses, see MPD `protocol/Ack.hxx`
+#define ACK_ERROR_ARG 2
+#define ACK_ERROR_UNKNOWN 5
+#define ACK_ERROR_NO_EXIST 50
+
+typedef enum IdleMask {
+	IDLE_PLAYER   = 1 << 0,
+	IDLE_PLAYLIST = 1 << 1,
+} IdleMask;
+
+typedef struct Out {
+	char *data;
+	size_t len;
+	size_t cap;
+} Out;
+
+typedef struct Reader {
+	int fd;
+	char buf[LINE_CAP * 4];
+	size_t len;
+} Reader;
+
+static FakeMpdConfig config;
+static int listen_fd = -1;
+static int songs_per_album = 1;
+
+// Encoded PNG served by `readpicture`
+static unsigned char *cover = NULL;
+static int cover_len = 0;
+
+// Song index (in the database) by position
+static int *queue_songs = NULL;
+static unsigned *queue_ids = NULL;
+// Queue version at which the position was changed the last time
+static unsigned *queue_pos_versions = NULL;
+static unsigned queue_version = 1;
+
+static int cur_pos = 0;
+static bool playing = true;
+// Elapsed time at `play_start_ms`
+static double elapsed_s = 0.0;
+static double play_start_ms = 0.0;
+
+// Changes the client wasn't notified about yet, see `IdleMask`
+static unsigned pending_idle = 0;
+
+static void _out_reserve(Out *o, size_t n) {
+	if (o->len + n <= o->cap) return;
+	o->cap = MAX(o->cap * 2, o->len + n);
+	o->data = realloc(o->data, o->cap);
+}
+
+static void _out_bytes(Out *o, const void *data, size_t n) {
+	_out_reserve(o, n);
+	memcpy(o->data + o->len, data, n);
+	o->len += n;
+}
+
+static void _out_printf(Out *o, const char *fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	int n = vsnprintf(NULL, 0, fmt, args);
+	va_end(args);
+
+	_out_reserve(o, (size_t)n + 1);
+
+	va_start(args, fmt);
+	vsnprintf(o->data + o->len, (size_t)n + 1, fmt, args);
+	va_end(args);
+	o->len += n;
+}
+
+static bool _out_flush(Out *o, int fd) {
+	size_t sent = 0;
+	while (sent < o->len) {
+		ssize_t res = send(fd, o->data + sent, o->len - sent, MSG_NOSIGNAL);
+		if (res <= 0) return false;
+		sent += (size_t)res;
+	}
+	o->len = 0;
+	return true;
+}
+
+// Returns `false` on EOF or error
+static bool _read_line(Reader *r, char (*line)[LINE_CAP]) {
+	while (true) {
+		char *end = memchr(r->buf, '\n', r->len);
+		if (end) {
+			size_t len = (size_t)(end - r->buf);
+			size_t copy = MIN(len, (size_t)LINE_CAP - 1);
+			memcpy(*line, r->buf, copy);
+			(*line)[copy] = '\0';
+
+			r->len -= len + 1;
+			memmove(r->buf, end + 1, r->len);
+			return true;
+		}
+
+		// Line is too long
+		if (r->len == sizeof(r->buf)) return false;
+
+		ssize_t res = read(r->fd, r->buf + r->len, sizeof(r->buf) - r->len);
+		if (res <= 0) return false;
+		r->len += (size_t)res;
+	}
+}
+
+// Split command line into arguments in place, quoted arguments are unescaped
+// Returns number of the arguments
+static int _split_args(char *line, char *(*args)[MAX_ARGS]) {
+	int argc = 0;
+	char *p = line;
+	while (*p != '\0' && argc < MAX_ARGS) {
+		while (*p == ' ' || *p == '\t') p++;
+		if (*p == '\0') break;
+
+		if (*p == '"') {
+			p++;
+			char *dst = p;
+			(*args)[argc++] = p;
+			while (*p != '\0' && *p != '"') {
+				if (*p == '\\' && p[1] != '\0') p++;
+				*dst++ = *p++;
+			}
+			if (*p == '"') p++;
+			*dst = '\0';
+		} else {
+			(*args)[argc++] = p;
+			while (*p != '\0' && *p != ' ' && *p != '\t') p++;
+			if (*p != '\0') *p++ = '\0';
+		}
+	}
+	return argc;
+}
+
+static void _sleep_ms(int ms) {
+	if (ms <= 0) return;
+	struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000 };
+	nanosleep(&ts, NULL);
+}
+
+static int _song_album(int song) {
+	return song / songs_per_album;
+}
+
+static int _song_duration(int song) {
+	return 180 + song % 120;
+}
+
+static double _elapsed(void) {
+	if (!playing) return elapsed_s;
+	return elapsed_s + (monotonic_ms() - play_start_ms) / 1000.0;
+}
+
+static void _set_elapsed(double elapsed) {
+	elapsed_s = elapsed;
+	play_start_ms = monotonic_ms();
+}
+
+static void _out_song(Out *o, int song) {
+	int album = _song_album(song);
+	int artist = album / ALBUMS_PER_ARTIST;
+	int track = song % songs_per_album + 1;
+
+	_out_printf(o,
+		"file: Artist %04d/Album %05d/%02d.flac\n"
+		"Last-Modified: 2024-01-01T00:00:00Z\n"
+		"Artist: Artist %04d\n"
+		"Album: Album %05d\n"
+		"Title: Song %d\n"
+		"Track: %d\n"
+		"Time: %d\n"
+		"duration: %d.000\n",
+		artist, album, track,
+		artist,
+		album,
+		song,
+		track,
+		_song_duration(song),
+		_song_duration(song)
+	);
+}
+
+static void _out_queue_song(Out *o, int pos) {
+	_out_song(o, queue_songs[pos]);
+	_out_printf(o, "Pos: %d\nId: %u\n", pos, queue_ids[pos]);
+}
+
+static int _find_pos(unsigned id) {
+	for (int pos = 0; pos < config.songs; pos++) {
+		if (queue_ids[pos] == id) return pos;
+	}
+	return -1;
+}
+
+static void _out_status(Out *o) {
+	int duration = _song_duration(queue_songs[cur_pos]);
+	double elapsed = _elapsed();
+
+	_out_printf(o,
+		"volume: 100\n"
+		"repeat: 0\n"
+		"random: 0\n"
+		"single: 0\n"
+		"consume: 0\n"
+		"playlist: %u\n"
+		"playlistlength: %d\n"
+		"state: %s\n"
+		"song: %d\n"
+		"songid: %u\n"
+		"time: %d:%d\n"
+		"elapsed: %.3f\n"
+		"duration: %d.000\n",
+		queue_version,
+		config.songs,
+		playing ? "play" : "pause",
+		cur_pos,
+		queue_ids[cur_pos],
+		(int)elapsed, duration,
+		elapsed,
+		duration
+	);
+}
+
+static void _out_idle(Out *o) {
+	if (pending_idle & IDLE_PLAYER)
+		_out_printf(o, "changed: player\n");
+	if (pending_idle & IDLE_PLAYLIST)
+		_out_printf(o, "changed: playlist\n");
+	pending_idle = 0;
+}
+
+// Handle `find` with either an expression (which matches every song, all
+// of them have an album) or "Album"/"Artist" tag constraints
+static const char *_cmd_find(Out *o, int argc, char **argv) {
+	int album = -1;
+	int artist = -1;
+	unsigned win_start = 0, win_end = (unsigned)-1;
+
+	for (int i = 1; i < argc; i++) {
+		if (argv[i][0] == '(') continue;
+
+		if (i + 1 >= argc) return "missing argument";
+
+		if (strcasecmp(argv[i], "window") == 0) {
+			if (sscanf(argv[i + 1], "%u:%u", &win_start, &win_end) != 2)
+				return "invalid window";
+		} else if (strcasecmp(argv[i], "album") == 0) {
+			if (sscanf(argv[i + 1], "Album %d", &album) != 1) album = config.albums;
+		} else if (strcasecmp(argv[i], "artist") == 0) {
+			if (sscanf(argv[i + 1], "Artist %d", &artist) != 1) artist = config.albums;
+		} else {
+			return "unsupported filter";
+		}
+		i += 1;
+	}
+
+	int from = 0, to = config.songs;
+	if (album >= 0) {
+		from = MIN(album * songs_per_album, config.songs);
+		to = MIN(from + songs_per_album, config.songs);
+	}
+
+	unsigned matched = 0;
+	for (int song = from; song < to && matched < win_end; song++) {
+		if (artist >= 0 && _song_album(song) / ALBUMS_PER_ARTIST != artist) continue;
+
+		if (matched >= win_start) _out_song(o, song);
+		matched += 1;
+	}
+
+	return NULL;
+}
+
+static const char *_cmd_readpicture(Out *o, int argc, char **argv) {
+	if (argc < 3) return "missing argument";
+
+	int offset = atoi(argv[2]);
+	if (offset < 0 || offset > cover_len) return "bad offset";
+
+	int chunk = MIN(cover_len - offset, config.binary_limit);
+	_out_printf(o, "size: %d\ntype: image/png\nbinary: %d\n", cover_len, chunk);
+	_out_bytes(o, cover + offset, (size_t)chunk);
+	_out_bytes(o, "\n", 1);
+	return NULL;
+}
+
+static const char *_cmd_move(int argc, char **argv) {
+	if (argc < 3) return "missing argument";
+
+	int from = atoi(argv[1]);
+	int to = atoi(argv[2]);
+	if (from < 0 || from >= config.songs || to < 0 || to >= config.songs)
+		return "bad song index";
+	if (from == to) return NULL;
+
+	int song = queue_songs[from];
+	unsigned id = queue_ids[from];
+	int step = from < to ? 1 : -1;
+	for (int pos = from; pos != to; pos += step) {
+		queue_songs[pos] = queue_songs[pos + step];
+		queue_ids[pos] = queue_ids[pos + step];
+	}
+	queue_songs[to] = song;
+	queue_ids[to] = id;
+
+	if (cur_pos == from)
+		cur_pos = to;
+	else if (from < to && cur_pos > from && cur_pos <= to)
+		cur_pos -= 1;
+	else if (from > to && cur_pos >= to && cur_pos < from)
+		cur_pos += 1;
+
+	queue_version += 1;
+	for (int pos = MIN(from, to); pos <= MAX(from, to); pos++)
+		queue_pos_versions[pos] = queue_version;
+
+	pending_idle |= IDLE_PLAYLIST;
+	return NULL;
+}
+
+// Returns error message or `NULL` on success
+static const char *_run_command(Out *o, int argc, char **argv, int *ack) {
+	const char *cmd = argv[0];
+	*ack = ACK_ERROR_ARG;
+
+	if (strcmp(cmd, "ping") == 0) {
+		return NULL;
+	} else if (strcmp(cmd, "status") == 0) {
+		_out_status(o);
+	} else if (strcmp(cmd, "currentsong") == 0) {
+		_out_queue_song(o, cur_pos);
+	} else if (strcmp(cmd, "playlistid") == 0) {
+		if (argc < 2) return "missing argument";
+		int pos = _find_pos((unsigned)strtoul(argv[1], NULL, 10));
+		if (pos < 0) {
+			*ack = ACK_ERROR_NO_EXIST;
+			return "No such song";
+		}
+		_out_queue_song(o, pos);
+	} else if (strcmp(cmd, "plchanges") == 0 || strcmp(cmd, "plchangesposid") == 0) {
+		if (argc < 2) return "missing argument";
+		unsigned version = (unsigned)strtoul(argv[1], NULL, 10);
+		bool meta = strcmp(cmd, "plchanges") == 0;
+		for (int pos = 0; pos < config.songs; pos++) {
+			if (queue_pos_versions[pos] <= version) continue;
+			if (meta)
+				_out_queue_song(o, pos);
+			else
+				_out_printf(o, "cpos: %d\nId: %u\n", pos, queue_ids[pos]);
+		}
+	} else if (strcmp(cmd, "list") == 0) {
+		if (argc < 2 || strcasecmp(argv[1], "album") != 0) return "unsupported tag";
+		for (int album = 0; album < config.albums; album++) {
+			if (album % ALBUMS_PER_ARTIST == 0)
+				_out_printf(o, "Artist: Artist %04d\n", album / ALBUMS_PER_ARTIST);
+			_out_printf(o, "Album: Album %05d\n", album);
+		}
+	} else if (strcmp(cmd, "find") == 0) {
+		return _cmd_find(o, argc, argv);
+	} else if (strcmp(cmd, "readpicture") == 0) {
+		return _cmd_readpicture(o, argc, argv);
+	} else if (strcmp(cmd, "binarylimit") == 0) {
+		if (argc < 2) return "missing argument";
+		config.binary_limit = MAX(atoi(argv[1]), 64);
+	} else if (strcmp(cmd, "pause") == 0) {
+		bool pause = argc >= 2 ? atoi(argv[1]) != 0 : playing;
+		_set_elapsed(_elapsed());
+		playing = !pause;
+		pending_idle |= IDLE_PLAYER;
+	} else if (strcmp(cmd, "next") == 0 || strcmp(cmd, "previous") == 0) {
+		int step = strcmp(cmd, "next") == 0 ? 1 : -1;
+		cur_pos = CLAMP(cur_pos + step, 0, config.songs - 1);
+		_set_elapsed(0.0);
+		pending_idle |= IDLE_PLAYER;
+	} else if (strcmp(cmd, "seekcur") == 0) {
+		if (argc < 2) return "missing argument";
+		_set_elapsed(atof(argv[1]));
+		pending_idle |= IDLE_PLAYER;
+	} else if (strcmp(cmd, "playid") == 0) {
+		if (argc < 2) return "missing argument";
+		int pos = _find_pos((unsigned)strtoul(argv[1], NULL, 10));
+		if (pos < 0) {
+			*ack = ACK_ERROR_NO_EXIST;
+			return "No such song";
+		}
+		cur_pos = pos;
+		playing = true;
+		_set_elapsed(0.0);
+		pending_idle |= IDLE_PLAYER;
+	} else if (strcmp(cmd, "move") == 0) {
+		return _cmd_move(argc, argv);
+	} else {
+		*ack = ACK_ERROR_UNKNOWN;
+		return "unknown command";
+	}
+
+	return NULL;
+}
+
+static void _serve(int fd) {
+	Reader *r = calloc(1, sizeof(Reader));
+	r->fd = fd;
+	Out out = {0};
+
+	char (*list)[LINE_CAP] = malloc(sizeof(*list) * MAX_LIST_LEN);
+	char line[LINE_CAP];
+	char *argv[MAX_ARGS];
+	bool idling = false;
+
+	_out_printf(&out, "OK MPD 0.23.5\n");
+	if (!_out_flush(&out, fd)) goto defer;
+
+	while (_read_line(r, &line)) {
+		int argc = _split_args(line, &argv);
+		if (argc == 0) continue;
+
+		// Like MPD, ignore "noidle" if the client isn't idling
+		if (strcmp(argv[0], "noidle") == 0) {
+			if (!idling) continue;
+			_sleep_ms(config.latency_ms);
+			_out_idle(&out);
+			_out_printf(&out, "OK\n");
+			idling = false;
+		} else if (idling) {
+			fprintf(stderr, "FAKE MPD: Command \"%s\" was sent while idling\n", argv[0]);
+			break;
+		} else if (strcmp(argv[0], "idle") == 0) {
+			// Pending changes are sent right away, otherwise changes can
+			// only be made by this client, so just wait for "noidle"
+			if (pending_idle == 0) {
+				idling = true;
+				continue;
+			}
+			_sleep_ms(config.latency_ms);
+			_out_idle(&out);
+			_out_printf(&out, "OK\n");
+		} else if (strcmp(argv[0], "command_list_begin") == 0 || strcmp(argv[0], "command_list_ok_begin") == 0) {
+			bool list_ok = strcmp(argv[0], "command_list_ok_begin") == 0;
+
+			int len = 0;
+			bool closed = false;
+			while (_read_line(r, &list[len])) {
+				if (strcmp(list[len], "command_list_end") == 0) {
+					closed = true;
+					break;
+				}
+				if (len < MAX_LIST_LEN - 1) len += 1;
+			}
+			if (!closed) break;
+
+			_sleep_ms(config.latency_ms);
+
+			bool failed = false;
+			for (int i = 0; i < len; i++) {
+				char *list_argv[MAX_ARGS];
+				int list_argc = _split_args(list[i], &list_argv);
+				if (list_argc == 0) continue;
+
+				int ack;
+				const char *err = _run_command(&out, list_argc, list_argv, &ack);
+				if (err) {
+					_out_printf(&out, "ACK [%d@%d] {%s} %s\n", ack, i, list_argv[0], err);
+					failed = true;
+					break;
+				}
+				if (list_ok) _out_printf(&out, "list_OK\n");
+			}
+			if (!failed) _out_printf(&out, "OK\n");
+		} else {
+			_sleep_ms(config.latency_ms);
+
+			int ack;
+			const char *err = _run_command(&out, argc, argv, &ack);
+			if (err)
+				_out_printf(&out, "ACK [%d@0] {%s} %s\n", ack, argv[0], err);
+			else
+				_out_printf(&out, "OK\n");
+		}
+
+		if (!_out_flush(&out, fd)) break;
+	}
+
+defer:
+	close(fd);
+	free(list);
+	free(out.data);
+	free(r);
+}
+
+static void *_fake_mpd_thread(void *arg) {
+	(void)arg;
+
+	while (true) {
+		int fd = accept(listen_fd, NULL, NULL);
+		if (fd < 0) continue;
+		_serve(fd);
+	}
+
+	return NULL;
+}
+
+int fake_mpd_start(FakeMpdConfig cfg) {
+	assert(cfg.songs > 0 && cfg.albums > 0 && cfg.albums <= cfg.songs);
+	config = cfg;
+	songs_per_album = (config.songs + config.albums - 1) / config.albums;
+
+	queue_songs = malloc(sizeof(int) * config.songs);
+	queue_ids = malloc(sizeof(unsigned) * config.songs);
+	queue_pos_versions = malloc(sizeof(unsigned) * config.songs);
+	for (int pos = 0; pos < config.songs; pos++) {
+		queue_songs[pos] = pos;
+		queue_ids[pos] = (unsigned)pos + 1;
+		queue_pos_versions[pos] = queue_version;
+	}
+	_set_elapsed(0.0);
+
+	Image image = GenImagePerlinNoise(config.cover_size, config.cover_size, 0, 0, 8.0f);
+	cover = ExportImageToMemory(image, ".png", &cover_len);
+	UnloadImage(image);
+	if (cover == NULL) {
+		fprintf(stderr, "FAKE MPD: Unable to encode the cover\n");
+		abort();
+	}
+
+	listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (listen_fd < 0) {
+		perror("FAKE MPD: socket()");
+		abort();
+	}
+
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = 0, // any free port
+		.sin_addr = { .s_addr = htonl(INADDR_LOOPBACK) },
+	};
+	socklen_t addr_len = sizeof(addr);
+	if (false
+		|| bind(listen_fd, (struct sockaddr*)&addr, addr_len) != 0
+		|| listen(listen_fd, 4) != 0
+		|| getsockname(listen_fd, (struct sockaddr*)&addr, &addr_len) != 0
+	) {
+		perror("FAKE MPD: Unable to listen");
+		abort();
+	}
+
+	pthread_t thread;
+	assert(pthread_create(&thread, NULL, _fake_mpd_thread, NULL) == 0);
+	pthread_detach(thread);
+
+	int port = ntohs(addr.sin_port);
+	fprintf(
+		stderr,
+		"FAKE MPD: Serving %d songs in %d albums on port %d (cover %d bytes, latency %dms)\n",
+		config.songs, config.albums, port, cover_len, config.latency_ms
+	);
+	return port;
+}
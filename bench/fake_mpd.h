@@ -0,0 +1,37 @@
+#ifndef FAKE_MPD_H
+#define FAKE_MPD_H
+
+// Scripted MPD server speaking just enough of the protocol for MUPWIT
+//
+// The database consists of `songs` songs evenly split between `albums`
+// albums (4 albums per artist), all of them are in the queue, the first one
+// is playing. Every song has the same embedded cover, a noise image which
+// doesn't compress well, like a real photo.
+// Only a single connection is served at a time.
+
+typedef struct FakeMpdConfig {
+	int songs;
+	int albums;
+	// Width and height of the cover in pixels
+	int cover_size;
+	// Delay before responding to every command (or command list), simulates
+	// the round trip time to a remote server
+	int latency_ms;
+	// Max size of a `readpicture` chunk, see MPD `binarylimit` command
+	int binary_limit;
+} FakeMpdConfig;
+
+#define FAKE_MPD_DEFAULT_CONFIG ((FakeMpdConfig){ \
+	.songs = 50000, \
+	.albums = 5000, \
+	.cover_size = 1000, \
+	.latency_ms = 0, \
+	.binary_limit = 8192, \
+})
+
+// Generate the database and start serving on a random local port in
+// a background thread
+// Returns the port
+int fake_mpd_start(FakeMpdConfig config);
+
+#endif
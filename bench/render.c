@@ -0,0 +1,256 @@
+// Headless render benchmark of the queue and albums pages
+//
+// Feeds the pages synthetic queues and albums lists of different sizes,
+// scripts scrolling (and drag-reordering on the queue page) with raylib
+// automation events and reports frame time percentiles and draw calls per
+// frame. The window is hidden, but a display is still needed (use
+// `xvfb-run` on a machine without one). The client is not connected, so
+// artworks are never received.
+//
+// Usage:
+//     RELEASE=1 make bench
+//     ./build/bench_render [items...]
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <raylib.h>
+
+#include "../src/client.h"
+#include "../src/state.h"
+#include "../src/assets.h"
+#include "../src/context.h"
+#include "../src/utils.h"
+#include "../src/ui/draw.h"
+#include "../src/pages/queue_page.h"
+#include "../src/pages/albums_page.h"
+
+#define WARMUP_FRAMES 10
+#define SCROLL_FRAMES 120
+#define DRAG_FRAMES 60
+// Mouse wheel clicks per frame
+#define SCROLL_SPEED 3
+#define SONGS_PER_ALBUM 10
+#define ALBUMS_PER_ARTIST 4
+
+// `AutomationEventType` from raylib `rcore.c`, it is not exposed in
+// the header
+typedef enum InputEventType {
+	INPUT_MOUSE_BUTTON_UP = 5,
+	INPUT_MOUSE_BUTTON_DOWN = 6,
+	INPUT_MOUSE_POSITION = 7,
+	INPUT_MOUSE_WHEEL_MOTION = 8,
+} InputEventType;
+
+typedef enum BenchPage {
+	BENCH_QUEUE,
+	BENCH_ALBUMS,
+} BenchPage;
+
+typedef struct FrameStats {
+	double time_ms;
+	DrawStats draw;
+} FrameStats;
+
+static void _input(InputEventType type, int a, int b) {
+	PlayAutomationEvent((AutomationEvent){
+		.type = type,
+		.params = {a, b, 0, 0},
+	});
+}
+
+static int _compare_frames(const void *a, const void *b) {
+	double x = ((const FrameStats*)a)->time_ms;
+	double y = ((const FrameStats*)b)->time_ms;
+	return (x > y) - (x < y);
+}
+
+static struct mpd_entity *_song_entity(int song) {
+	int album = song / SONGS_PER_ALBUM;
+	char file[64], artist[32], album_str[32], title[32], time[16], pos[16], id[16];
+	snprintf(file, sizeof(file), "Artist %04d/Album %05d/%02d.flac",
+		album / ALBUMS_PER_ARTIST, album, song % SONGS_PER_ALBUM + 1);
+	snprintf(artist, sizeof(artist), "Artist %04d", album / ALBUMS_PER_ARTIST);
+	snprintf(album_str, sizeof(album_str), "Album %05d", album);
+	snprintf(title, sizeof(title), "Song number %d", song);
+	snprintf(time, sizeof(time), "%d", 180 + song % 120);
+	snprintf(pos, sizeof(pos), "%d", song);
+	snprintf(id, sizeof(id), "%d", song + 1);
+
+	struct mpd_entity *entity = mpd_entity_begin(&(struct mpd_pair){"file", file});
+	mpd_entity_feed(entity, &(struct mpd_pair){"Artist", artist});
+	mpd_entity_feed(entity, &(struct mpd_pair){"Album", album_str});
+	mpd_entity_feed(entity, &(struct mpd_pair){"Title", title});
+	mpd_entity_feed(entity, &(struct mpd_pair){"Time", time});
+	mpd_entity_feed(entity, &(struct mpd_pair){"Pos", pos});
+	mpd_entity_feed(entity, &(struct mpd_pair){"Id", id});
+	return entity;
+}
+
+static Event _queue_event(int items) {
+	EventDataQueue changes = { .queue_len = (unsigned)items };
+	for (int i = 0; i < items; i++) {
+		DA_PUSH(&changes, ((QueueChange){
+			.pos = (unsigned)i,
+			.id = (unsigned)i + 1,
+			.entity_nullable = _song_entity(i),
+		}));
+	}
+	return (Event){ .kind = EVENT_QUEUE_CHANGED, .data = { .queue = changes } };
+}
+
+static Event _albums_event(int items) {
+	EventDataAlbumsList albums = {0};
+	char buf[64];
+	for (int i = 0; i < items; i++) {
+		AlbumInfo info = {0};
+
+		snprintf(buf, sizeof(buf), "Album %05d", i);
+		info.title = strdup(buf);
+		snprintf(buf, sizeof(buf), "Artist %04d", i / ALBUMS_PER_ARTIST);
+		info.artist_nullable = strdup(buf);
+		snprintf(buf, sizeof(buf), "Artist %04d/Album %05d/01.flac", i / ALBUMS_PER_ARTIST, i);
+		info.first_song_uri_nullable = strdup(buf);
+
+		DA_PUSH(&albums, info);
+	}
+	return (Event){ .kind = EVENT_ALBUMS_LIST_CHANGED, .data = { .albums = albums } };
+}
+
+// Script input of the frame
+// Scrolls down, drags an item on the queue page and scrolls back up
+static void _script_frame(BenchPage page, int frame) {
+	int sw = GetScreenWidth();
+	int sh = GetScreenHeight();
+
+	int drag_start = SCROLL_FRAMES;
+	int drag_end = drag_start + (page == BENCH_QUEUE ? DRAG_FRAMES : 0);
+
+	if (frame < drag_start) {
+		_input(INPUT_MOUSE_POSITION, sw / 2, sh / 3);
+		_input(INPUT_MOUSE_WHEEL_MOTION, 0, -SCROLL_SPEED);
+	} else if (frame < drag_end) {
+		int step = frame - drag_start;
+		_input(INPUT_MOUSE_POSITION, sw / 2, sh / 3 + step * 4);
+		if (step == 0)
+			_input(INPUT_MOUSE_BUTTON_DOWN, MOUSE_BUTTON_LEFT, 0);
+		else if (step == DRAG_FRAMES - 1)
+			_input(INPUT_MOUSE_BUTTON_UP, MOUSE_BUTTON_LEFT, 0);
+	} else {
+		_input(INPUT_MOUSE_WHEEL_MOTION, 0, SCROLL_SPEED);
+	}
+}
+
+static void _bench_page(Context ctx, BenchPage page, int items) {
+	Queue queue = queue_page_new();
+	Albums albums = albums_page_new();
+
+	ctx.state->page = page == BENCH_QUEUE ? PAGE_QUEUE : PAGE_ALBUMS;
+	ctx.state->prev_page = ctx.state->page;
+	ctx.state->page_transition = 1.0;
+
+	double load_start = monotonic_ms();
+	if (page == BENCH_QUEUE)
+		queue_page_on_event(&queue, _queue_event(items), ctx);
+	else
+		albums_page_on_event(&albums, _albums_event(items), ctx);
+	double load_time = monotonic_ms() - load_start;
+
+	int frames = SCROLL_FRAMES * 2 + (page == BENCH_QUEUE ? DRAG_FRAMES : 0);
+	FrameStats *stats = calloc(frames, sizeof(FrameStats));
+	double draw_calls = 0, flushes = 0;
+	int max_draw_calls = 0;
+
+	for (int frame = -WARMUP_FRAMES; frame < frames; frame++) {
+		if (frame >= 0) _script_frame(page, frame);
+
+		double start = monotonic_ms();
+
+		BeginDrawing();
+		ClearBackground(ctx.state->background);
+		ctx.state->container = screen_rect();
+
+		if (page == BENCH_QUEUE)
+			queue_page_draw(&queue, ctx);
+		else
+			albums_page_draw(&albums, ctx);
+
+		DrawStats draw = draw_stats_end_frame();
+		EndDrawing();
+		texture_cache_end_frame(&ctx.state->artworks);
+
+		if (frame < 0) continue;
+
+		stats[frame] = (FrameStats){
+			.time_ms = monotonic_ms() - start,
+			.draw = draw,
+		};
+		draw_calls += draw.draw_calls;
+		flushes += draw.flushes;
+		max_draw_calls = MAX(max_draw_calls, draw.draw_calls);
+	}
+
+	qsort(stats, frames, sizeof(FrameStats), _compare_frames);
+
+	printf(
+		"%-6s %6d items: load %8.2f ms, frame p50 %6.2f ms, p90 %6.2f ms, p99 %6.2f ms, max %6.2f ms, "
+		"%.0f draw calls (max %d), %.0f flushes\n",
+		page == BENCH_QUEUE ? "queue" : "albums",
+		items,
+		load_time,
+		stats[frames / 2].time_ms,
+		stats[frames * 9 / 10].time_ms,
+		stats[frames * 99 / 100].time_ms,
+		stats[frames - 1].time_ms,
+		draw_calls / frames,
+		max_draw_calls,
+		flushes / frames
+	);
+
+	free(stats);
+	queue_page_free(&queue);
+	albums_page_free(&albums);
+}
+
+int main(int argc, char **argv) {
+	SetTraceLogLevel(LOG_ERROR);
+	SetConfigFlags(FLAG_WINDOW_HIDDEN);
+	InitWindow(THEME_WINDOW_WIDTH, THEME_WINDOW_HEIGHT, "MUPWIT bench");
+	if (!IsWindowReady()) {
+		fprintf(stderr, "ERROR: Unable to create a window, is there a display?\n");
+		return 1;
+	}
+
+	draw_stats_enable();
+
+	Client client = client_new();
+	State state = state_new();
+	Assets assets = assets_new();
+	Context ctx = {
+		.state = &state,
+		.client = &client,
+		.assets = &assets,
+	};
+
+	int sizes[16] = {1000, 10000, 100000};
+	int sizes_len = 3;
+	if (argc > 1) {
+		sizes_len = MIN(argc - 1, 16);
+		for (int i = 0; i < sizes_len; i++) sizes[i] = atoi(argv[i + 1]);
+	}
+
+	for (int i = 0; i < sizes_len; i++) {
+		int items = sizes[i];
+		if (items <= 0) continue;
+
+		_bench_page(ctx, BENCH_QUEUE, items);
+		_bench_page(ctx, BENCH_ALBUMS, items);
+	}
+
+	CloseWindow();
+	state_free(&state);
+	return 0;
+}
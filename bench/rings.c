@@ -0,0 +1,201 @@
+// Stress test and micro-benchmark of the lock-free ring buffers
+//
+// Several producers push sequence numbers into an MPSC ring (and one producer
+// into an SPSC ring) while a single consumer pops them and checks that no item
+// is lost, duplicated or reordered within a producer. The same workload is then
+// run over a mutex-guarded ring, the way actions and events were queued before.
+//
+// Exits with a non-zero status if any check fails.
+//
+// Usage:
+//     RELEASE=1 make bench
+//     ./build/bench_rings [producers]
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "../src/macros.h"
+
+#define RING_CAP 16
+#define ITEMS_PER_PRODUCER 1000000
+#define MAX_PRODUCERS 16
+
+typedef struct Item {
+	unsigned producer;
+	unsigned seq;
+} Item;
+
+typedef struct SpscRing {
+	SPSC_RING_FIELDS(Item, RING_CAP)
+} SpscRing;
+
+typedef struct MpscRing {
+	MPSC_RING_FIELDS(Item, RING_CAP)
+} MpscRing;
+
+// Ring guarded by a mutex, what the client used before
+typedef struct MutexRing {
+	pthread_mutex_t mutex;
+	size_t head;
+	size_t len;
+	Item buffer[RING_CAP];
+} MutexRing;
+
+typedef enum RingKind {
+	RING_SPSC,
+	RING_MPSC,
+	RING_MUTEX,
+} RingKind;
+
+typedef struct Bench {
+	RingKind kind;
+	unsigned producers;
+
+	SpscRing spsc;
+	MpscRing mpsc;
+	MutexRing mutex;
+} Bench;
+
+typedef struct Producer {
+	Bench *bench;
+	unsigned id;
+} Producer;
+
+static double _now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+static bool _bench_push(Bench *b, Item item) {
+	bool pushed = false;
+	switch (b->kind) {
+	case RING_SPSC:
+		SPSC_RING_PUSH(&b->spsc, item, pushed);
+		break;
+	case RING_MPSC:
+		MPSC_RING_PUSH(&b->mpsc, item, pushed);
+		break;
+	case RING_MUTEX:
+		LOCK(&b->mutex.mutex);
+		pushed = b->mutex.len < RING_CAP;
+		if (pushed) {
+			b->mutex.buffer[(b->mutex.head + b->mutex.len) % RING_CAP] = item;
+			b->mutex.len += 1;
+		}
+		UNLOCK(&b->mutex.mutex);
+		break;
+	}
+	return pushed;
+}
+
+static bool _bench_pop(Bench *b, Item *item) {
+	bool popped = false;
+	switch (b->kind) {
+	case RING_SPSC:
+		SPSC_RING_POP(&b->spsc, item, popped);
+		break;
+	case RING_MPSC:
+		MPSC_RING_POP(&b->mpsc, item, popped);
+		break;
+	case RING_MUTEX:
+		LOCK(&b->mutex.mutex);
+		popped = b->mutex.len > 0;
+		if (popped) {
+			*item = b->mutex.buffer[b->mutex.head];
+			b->mutex.head = (b->mutex.head + 1) % RING_CAP;
+			b->mutex.len -= 1;
+		}
+		UNLOCK(&b->mutex.mutex);
+		break;
+	}
+	return popped;
+}
+
+static void *_producer(void *producer_) {
+	Producer *p = producer_;
+	for (unsigned seq = 0; seq < ITEMS_PER_PRODUCER; seq++) {
+		Item item = {p->id, seq};
+		while (!_bench_push(p->bench, item))
+			sched_yield();
+	}
+	return NULL;
+}
+
+// Returns whether all the checks passed
+static bool _bench_run(const char *name, RingKind kind, unsigned producers) {
+	Bench *b = calloc(1, sizeof(Bench));
+	b->kind = kind;
+	b->producers = producers;
+	MPSC_RING_INIT(&b->mpsc);
+	assert(pthread_mutex_init(&b->mutex.mutex, NULL) == 0);
+
+	unsigned next_seq[MAX_PRODUCERS] = {0};
+	Producer ps[MAX_PRODUCERS];
+	pthread_t threads[MAX_PRODUCERS];
+
+	double start = _now_ms();
+
+	for (unsigned i = 0; i < producers; i++) {
+		ps[i] = (Producer){b, i};
+		assert(pthread_create(&threads[i], NULL, _producer, &ps[i]) == 0);
+	}
+
+	bool ok = true;
+	size_t total = (size_t)producers * ITEMS_PER_PRODUCER;
+	for (size_t received = 0; received < total;) {
+		Item item;
+		if (!_bench_pop(b, &item)) {
+			sched_yield();
+			continue;
+		}
+
+		if (item.producer >= producers || item.seq != next_seq[item.producer]) {
+			fprintf(stderr, "%s: expected item %u from producer %u, got %u\n",
+				name, next_seq[MIN(item.producer, producers - 1)], item.producer, item.seq);
+			ok = false;
+			break;
+		}
+
+		next_seq[item.producer] += 1;
+		received += 1;
+	}
+
+	for (unsigned i = 0; i < producers; i++)
+		pthread_join(threads[i], NULL);
+
+	double elapsed = _now_ms() - start;
+
+	Item item;
+	if (ok && _bench_pop(b, &item)) {
+		fprintf(stderr, "%s: ring is not empty after all items were received\n", name);
+		ok = false;
+	}
+
+	printf("%-6s %2u producer(s): %8.2f ms, %6.1f ns/item%s\n",
+		name, producers, elapsed, elapsed * 1000000.0 / (double)total,
+		ok ? "" : " FAILED");
+
+	pthread_mutex_destroy(&b->mutex.mutex);
+	free(b);
+	return ok;
+}
+
+int main(int argc, char **argv) {
+	unsigned producers = 4;
+	if (argc > 1) producers = (unsigned)atoi(argv[1]);
+	producers = CLAMP(producers, 1u, (unsigned)MAX_PRODUCERS);
+
+	bool ok = true;
+	ok = _bench_run("spsc", RING_SPSC, 1) && ok;
+	ok = _bench_run("mutex", RING_MUTEX, 1) && ok;
+	ok = _bench_run("mpsc", RING_MPSC, producers) && ok;
+	ok = _bench_run("mutex", RING_MUTEX, producers) && ok;
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,235 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "./artwork_cache.h"
+#include "./macros.h"
+#include "./utils.h"
+
+#define PATH_CAP 512
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME  0x100000001b3ULL
+
+#define FILE_MAGIC "MPWA"
+// Bump it every time the file layout changes so old files get ignored
+#define FILE_VERSION 1
+
+typedef struct FileHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	Color color;
+} FileHeader;
+
+// Path to the cache directory without trailing slash
+// Empty if caching is disabled
+static char cache_dir[PATH_CAP] = {0};
+
+static uint64_t _hash_str(uint64_t hash, const char *s) {
+	for (; *s != '\0'; s++) {
+		hash ^= (unsigned char)*s;
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+// Create directory and all its parents
+// Returns whether the directory exists
+static bool _mkdir_all(char *path) {
+	for (char *p = path + 1; *p != '\0'; p++) {
+		if (*p != '/') continue;
+
+		*p = '\0';
+		int res = mkdir(path, 0755);
+		*p = '/';
+
+		if (res != 0 && errno != EEXIST) return false;
+	}
+
+	return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+static void _artwork_cache_path(char (*path)[PATH_CAP], uint64_t key, int size) {
+	snprintf(*path, PATH_CAP, "%s/%016llx-%d.rgba", cache_dir, (unsigned long long)key, size);
+}
+
+void artwork_cache_init(void) {
+	const char *xdg_cache = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+
+	int len;
+	if (xdg_cache && xdg_cache[0] == '/') {
+		len = snprintf(cache_dir, PATH_CAP, "%s/mupwit/artworks", xdg_cache);
+	} else if (home && home[0] != '\0') {
+		len = snprintf(cache_dir, PATH_CAP, "%s/.cache/mupwit/artworks", home);
+	} else {
+		TraceLog(LOG_WARNING, "ARTWORK CACHE: Neither $XDG_CACHE_HOME nor $HOME is set, artworks won't be cached");
+		cache_dir[0] = '\0';
+		return;
+	}
+
+	// Leave some space for the file names
+	if (len <= 0 || len >= PATH_CAP - 32) {
+		TraceLog(LOG_WARNING, "ARTWORK CACHE: Cache directory path is too long, artworks won't be cached");
+		cache_dir[0] = '\0';
+		return;
+	}
+
+	if (!_mkdir_all(cache_dir)) {
+		TraceLog(LOG_WARNING, "ARTWORK CACHE: Unable to create %s, artworks won't be cached", cache_dir);
+		cache_dir[0] = '\0';
+		return;
+	}
+
+	TraceLog(LOG_INFO, "ARTWORK CACHE: Caching artworks in %s", cache_dir);
+}
+
+uint64_t artwork_key(
+	const char *album_nullable,
+	const char *artist_nullable,
+	const char *song_uri_nullable
+) {
+	uint64_t hash = FNV_OFFSET;
+
+	if (album_nullable && album_nullable[0] != '\0') {
+		hash = _hash_str(hash, "album:");
+		hash = _hash_str(hash, album_nullable);
+		hash = _hash_str(hash, "\x1f"); // unit separator
+		if (artist_nullable)
+			hash = _hash_str(hash, artist_nullable);
+	} else if (song_uri_nullable) {
+		hash = _hash_str(hash, "uri:");
+		hash = _hash_str(hash, song_uri_nullable);
+	} else {
+		return 0;
+	}
+
+	// 0 is reserved for "no key"
+	return hash == 0 ? 1 : hash;
+}
+
+int artwork_size_class(int size) {
+	int class = ARTWORK_MIN_SIZE;
+	while (class < size && class < ARTWORK_MAX_SIZE)
+		class *= 2;
+	return class;
+}
+
+uint64_t artwork_sized_key(uint64_t key, int size) {
+	// Mix the size into the hash
+	return (key ^ (uint64_t)size) * FNV_PRIME;
+}
+
+static bool _artwork_cache_load_level(uint64_t key, int size, Image *image, Color *color) {
+	char path[PATH_CAP];
+	_artwork_cache_path(&path, key, size);
+
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) return false;
+
+	unsigned char *data = NULL;
+
+	FileHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1) goto error;
+	if (memcmp(header.magic, FILE_MAGIC, 4) != 0) goto error;
+	if (header.version != FILE_VERSION) goto error;
+	if (header.width == 0 || header.width > (uint32_t)size) goto error;
+	if (header.height == 0 || header.height > (uint32_t)size) goto error;
+
+	size_t data_size = (size_t)header.width * header.height * 4;
+	data = MemAlloc(data_size);
+	if (fread(data, 1, data_size, file) != data_size) goto error;
+
+	fclose(file);
+
+	*image = (Image){
+		.data = data,
+		.width = header.width,
+		.height = header.height,
+		.mipmaps = 1,
+		.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8,
+	};
+	*color = header.color;
+	return true;
+
+error:
+	fclose(file);
+	MemFree(data);
+
+	TraceLog(LOG_WARNING, "ARTWORK CACHE: %s is corrupted or outdated, deleting it", path);
+	remove(path);
+	return false;
+}
+
+bool artwork_cache_load(uint64_t key, int size, Image *image, Color *color) {
+	if (cache_dir[0] == '\0' || key == 0) return false;
+
+	assert(size == artwork_size_class(size));
+
+	// Look for the requested level first and then for the larger ones
+	for (int level = size; level <= ARTWORK_MAX_SIZE; level *= 2) {
+		if (!_artwork_cache_load_level(key, level, image, color)) continue;
+
+		if (level != size) {
+			// Generate the requested level, so next time it is loaded directly
+			image_fit(image, size);
+			artwork_cache_save(key, size, *image, *color);
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+void artwork_cache_save(uint64_t key, int size, Image image, Color color) {
+	if (cache_dir[0] == '\0' || key == 0) return;
+
+	assert(image.data != NULL);
+	assert(image.format == PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+	assert(image.width <= size && image.height <= size);
+
+	char path[PATH_CAP];
+	_artwork_cache_path(&path, key, size);
+
+	// Write into a temporary file first and then rename it, so readers never
+	// see a half-written file and concurrent writers don't corrupt each other
+	char tmp_path[PATH_CAP + 24];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.%lx", path, (unsigned long)pthread_self());
+
+	FILE *file = fopen(tmp_path, "wb");
+	if (file == NULL) {
+		TraceLog(LOG_WARNING, "ARTWORK CACHE: Unable to create %s", tmp_path);
+		return;
+	}
+
+	FileHeader header = {
+		.magic = FILE_MAGIC,
+		.version = FILE_VERSION,
+		.width = image.width,
+		.height = image.height,
+		.color = color,
+	};
+
+	size_t data_size = (size_t)image.width * image.height * 4;
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(image.data, 1, data_size, file);
+
+	bool failed = ferror(file) != 0;
+	failed = fclose(file) != 0 || failed;
+
+	if (failed || rename(tmp_path, path) != 0) {
+		TraceLog(LOG_WARNING, "ARTWORK CACHE: Unable to write %s", path);
+		remove(tmp_path);
+		return;
+	}
+
+	TraceLog(LOG_INFO, "ARTWORK CACHE: Saved %016llx-%d (%dx%d)", (unsigned long long)key, size, image.width, image.height);
+}
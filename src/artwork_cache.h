@@ -0,0 +1,54 @@
+#ifndef ARTWORK_CACHE_H
+#define ARTWORK_CACHE_H
+
+#include <stdint.h>
+#include <raylib.h>
+
+// Persistent on-disk cache of decoded album artworks.
+// Artworks are stored as downscaled RGBA thumbnails together with their
+// average color under `$XDG_CACHE_HOME/mupwit/artworks/` (or
+// `~/.cache/mupwit/artworks/`), so they don't have to be downloaded from the
+// MPD server and decoded again.
+
+// Artworks are stored in several sizes (mip levels), each level is a power
+// of two between these two values and defines the max width/height of
+// the thumbnail
+#define ARTWORK_MIN_SIZE 32
+#define ARTWORK_MAX_SIZE 512
+
+// Resolve and create the cache directory
+// Must be called once before any other `artwork_cache_*` function
+// If the directory cannot be created, the cache is silently disabled
+void artwork_cache_init(void);
+
+// Identity of an album artwork
+// Artworks are keyed by album title + album artist, so all songs of the same
+// album share the same artwork. Falls back to the song URI if the song
+// doesn't have an album tag.
+// Returns 0 if there is nothing to build a key from.
+uint64_t artwork_key(
+	const char *album_nullable,
+	const char *artist_nullable,
+	const char *song_uri_nullable
+);
+
+// Round on-screen size of the artwork up to the nearest mip level
+int artwork_size_class(int size);
+
+// Key of the artwork mip level, used to tell apart different sizes of
+// the same artwork in the texture cache
+uint64_t artwork_sized_key(uint64_t key, int size);
+
+// Try to load artwork thumbnail of the specified mip level from the cache.
+// If there is no such level, it is generated from the closest larger one.
+// Loaded image is always in `PIXELFORMAT_UNCOMPRESSED_R8G8B8A8` format.
+// Returns `true` on cache hit and assigns `image` and `color`.
+// Safe to call from any thread.
+bool artwork_cache_load(uint64_t key, int size, Image *image, Color *color);
+
+// Store artwork thumbnail of the specified mip level into the cache.
+// Image must be in `PIXELFORMAT_UNCOMPRESSED_R8G8B8A8` format.
+// Safe to call from any thread.
+void artwork_cache_save(uint64_t key, int size, Image image, Color color);
+
+#endif
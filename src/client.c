@@ -1,6 +1,8 @@
 #define _GNU_SOURCE
 
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -12,6 +14,8 @@
 #include "./client.h"
 #include "./macros.h"
 #include "./utils.h"
+#include "./artwork_cache.h"
+#include "./trace.h"
 
 // TODO: fetch 'albumart' if 'readpicture' returned nothing
 
@@ -50,66 +54,182 @@ Client client_new(void) {
 	assert(pthread_mutexattr_init(&mattr) == 0);
 	assert(pthread_mutexattr_settype(&mattr, PTHREAD_MUTEX_ERRORCHECK) == 0);
 
-	INIT_MUTEX(actions_mutex);
-
-	INIT_MUTEX(events_mutex);
 	INIT_MUTEX(reqs_mutex);
 
 	INIT_RWLOCK(state_rwlock);
 	INIT_RWLOCK(status_rwlock);
 
-	return (Client){
-		._actions_mutex = actions_mutex,
-		._actions = (ActionsQueue){
-			.cap = ACTIONS_QUEUE_CAP,
-			.buffer = {{0}},
-		},
+	artwork_cache_init();
 
-		._events_mutex = events_mutex,
-		._events = (EventsQueue){
-			.cap = EVENTS_QUEUE_CAP,
-			.buffer = {{0}},
-		},
+	int wake_fds[2];
+	int ui_wake_fds[2];
+	if (
+		pipe2(wake_fds, O_NONBLOCK | O_CLOEXEC) != 0
+		|| pipe2(ui_wake_fds, O_NONBLOCK | O_CLOEXEC) != 0
+	) {
+		TraceLog(LOG_ERROR, "MPD CLIENT: Unable to create wake pipe: %s", strerror(errno));
+		abort();
+	}
+
+	Client c = {
+		._actions = {0},
+
+		._wake_fds = {wake_fds[0], wake_fds[1]},
+		._ui_wake_fds = {ui_wake_fds[0], ui_wake_fds[1]},
 
 		._reqs_mutex = reqs_mutex,
 		._reqs = NULL,
-		._cur_req = NULL,
 		._last_req_id = 0,
 
+		._idle_debounce_ms = MAX(env_int("MUPWIT_IDLE_DEBOUNCE_MS", IDLE_DEBOUNCE_MS), 0),
+		._albums_batch_size = MAX(env_int("MUPWIT_ALBUMS_BATCH_SIZE", ALBUMS_LOOKUP_BATCH_SIZE), 0),
+
 		._state_rwlock = state_rwlock,
 		._status_rwlock = status_rwlock,
 	};
+
+	MPSC_RING_INIT(&c._events);
+
+	return c;
+}
+
+// Wake up the client thread if it is waiting in `_client_wait()`
+static void _client_wake(Client *c) {
+	char byte = 1;
+	// Pipe is non-blocking, if it is full the thread is going to wake up
+	// anyway
+	ssize_t res = write(c->_wake_fds[1], &byte, 1);
+	(void)res;
+}
+
+// Wake up the UI thread if it is waiting in `client_wait_events()`
+static void _client_wake_ui(Client *c) {
+	char byte = 1;
+	ssize_t res = write(c->_ui_wake_fds[1], &byte, 1);
+	(void)res;
+}
+
+bool client_wait_events(Client *c, int timeout_ms) {
+	struct pollfd fd = { .fd = c->_ui_wake_fds[0], .events = POLLIN };
+
+	int res = poll(&fd, 1, timeout_ms);
+	if (res < 0) {
+		// Interrupted by a signal, which may need to be handled too (see
+		// `should_close()`)
+		if (errno == EINTR) return true;
+
+		TraceLog(LOG_ERROR, "MPD CLIENT: poll() failed: %s", strerror(errno));
+		return false;
+	}
+	if (res == 0) return false;
+
+	char buf[64];
+	while (read(c->_ui_wake_fds[0], buf, sizeof(buf)) > 0);
+	return true;
 }
 
 void client_push_action(Client *c, Action action) {
-	LOCK(&c->_actions_mutex);
-	RINGBUF_PUSH(&c->_actions, action);
-	UNLOCK(&c->_actions_mutex);
+	bool pushed;
+	SPSC_RING_PUSH(&c->_actions, action, pushed);
+	if (!pushed) {
+		TraceLog(LOG_WARNING, "MPD CLIENT: Actions queue is full, action %d was dropped", action.kind);
+		return;
+	}
+
+	_client_wake(c);
 }
 void client_push_action_kind(Client *c, ActionKind action) {
 	client_push_action(c, (Action){action, {0}});
 }
 Action _client_pop_action(Client *c) {
 	Action action = {0};
-	LOCK(&c->_actions_mutex);
-	RINGBUF_POP(&c->_actions, &action, (Action){0});
-	UNLOCK(&c->_actions_mutex);
+	bool popped;
+	SPSC_RING_POP(&c->_actions, &action, popped);
+	(void)popped;
 	return action;
 }
 
-static void _client_push_event(Client *c, Event event) {
-	LOCK(&c->_events_mutex);
-	RINGBUF_PUSH(&c->_events, event);
-	UNLOCK(&c->_events_mutex);
+// Events without data are only marked as pending, see `EVENT_IS_SIGNAL()`
+// If the events queue is full, waits for the UI to pop some events for up to
+// `EVENT_PUSH_TIMEOUT_MS`
+// Returns `false` if the event was dropped, its data is freed in that case
+static bool _client_push_event(Client *c, Event event) {
+	if (EVENT_IS_SIGNAL(event.kind)) {
+		// Move the signal after the events pushed so far, the position is
+		// only advanced in case another producer raced us
+		size_t pos = atomic_load(&c->_events.enqueue_pos);
+		size_t prev = atomic_load(&c->_signal_pos[event.kind]);
+		while (prev < pos && !atomic_compare_exchange_weak(&c->_signal_pos[event.kind], &prev, pos));
+
+		unsigned bit = 1u << event.kind;
+		if (atomic_fetch_or(&c->_pending_signals, bit) & bit)
+			atomic_fetch_add(&c->_events_coalesced, 1);
+		else
+			_client_wake_ui(c);
+		return true;
+	}
+
+	bool pushed;
+	MPSC_RING_PUSH(&c->_events, event, pushed);
+	if (pushed) {
+		_client_wake_ui(c);
+		return true;
+	}
+
+	atomic_fetch_add(&c->_events_blocked, 1);
+
+	double deadline = monotonic_ms() + EVENT_PUSH_TIMEOUT_MS;
+	while (monotonic_ms() < deadline) {
+		nanosleep(&(struct timespec){.tv_nsec = 1000000}, NULL);
+
+		MPSC_RING_PUSH(&c->_events, event, pushed);
+		if (pushed) {
+			_client_wake_ui(c);
+			return true;
+		}
+	}
+
+	atomic_fetch_add(&c->_events_dropped, 1);
+	TraceLog(LOG_WARNING, "MPD CLIENT: Events queue is full for %dms, event %d was dropped", EVENT_PUSH_TIMEOUT_MS, event.kind);
+
+	event_free(event);
+	return false;
 }
 Event client_pop_event(Client *c) {
-	if (TRYLOCK(&c->_events_mutex) == 0) {
-		Event event = {0};
-		RINGBUF_POP(&c->_events, &event, (Event){0});
-		UNLOCK(&c->_events_mutex);
-		return event;
+	Event event = {0};
+	client_pop_events(c, &event, 1);
+	return event;
+}
+size_t client_pop_events(Client *c, Event *events, size_t cap) {
+	size_t len = 0;
+
+	// Events are popped in the order they were pushed: coalesced events go
+	// right after the ring events that were pushed before they were raised
+	// the last time
+	unsigned signals = atomic_exchange(&c->_pending_signals, 0);
+	while (len < cap) {
+		for (EventKind kind = EVENT_ELAPSED; EVENT_IS_SIGNAL(kind) && len < cap; kind++) {
+			unsigned bit = 1u << kind;
+			if ((signals & bit) == 0) continue;
+			if (atomic_load(&c->_signal_pos[kind]) > c->_events.dequeue_pos) continue;
+
+			events[len++] = (Event){.kind = kind};
+			signals &= ~bit;
+		}
+		if (len >= cap) break;
+
+		bool popped;
+		MPSC_RING_POP(&c->_events, &events[len], popped);
+		if (!popped) break;
+		len += 1;
 	}
-	return (Event){0};
+
+	// Put back the ones that didn't fit or wait for the events that are
+	// still being pushed
+	if (signals != 0)
+		atomic_fetch_or(&c->_pending_signals, signals);
+
+	return len;
 }
 
 static void _client_free_request(Client *c, Request *req) {
@@ -140,21 +260,80 @@ void client_cancel_request(Client *c, int id) {
 	UNLOCK(&c->_reqs_mutex);
 }
 
-int client_request(Client *c, const char *song_uri) {
-	LOCK(&c->_reqs_mutex);
-
+// Requests mutex must be locked
+static int _client_make_request(
+	Client *c,
+	uint64_t key,
+	int size,
+	const char *song_uri,
+	RequestPriority priority
+) {
 	Request *req = calloc(1, sizeof(Request));
 	req->id = ++ c->_last_req_id; // post-increment so id is always > 0
+	req->key = key;
+	req->size = artwork_size_class(size);
 	req->song_uri = strdup(song_uri);
+	req->priority = priority;
+	req->state = REQUEST_PENDING;
+	req->cache_missed = false;
 	req->canceled = false;
 
 	HASH_ADD_INT(c->_reqs, id, req);
 	TraceLog(LOG_INFO, "MPD CLIENT: Request %d has been made...", req->id);
 
-	UNLOCK(&c->_reqs_mutex);
 	return req->id;
 }
 
+int client_request(
+	Client *c,
+	uint64_t key,
+	int size,
+	const char *song_uri,
+	RequestPriority priority
+) {
+	LOCK(&c->_reqs_mutex);
+	int id = _client_make_request(c, key, size, song_uri, priority);
+	UNLOCK(&c->_reqs_mutex);
+
+	_client_wake(c);
+	return id;
+}
+
+void client_submit_requests(Client *c, RequestOp *ops, size_t len) {
+	if (len == 0) return;
+
+	bool wake = false;
+
+	LOCK(&c->_reqs_mutex);
+
+	for (size_t i = 0; i < len; i++) {
+		RequestOp *op = &ops[i];
+
+		if (op->kind == REQUEST_OP_MAKE) {
+			op->id = _client_make_request(c, op->key, op->size, op->song_uri, op->priority);
+			wake = true;
+			continue;
+		}
+
+		assert(op->id > 0);
+
+		Request *req = NULL;
+		HASH_FIND_INT(c->_reqs, &op->id, req);
+		if (!req) continue;
+
+		if (op->kind == REQUEST_OP_CANCEL) {
+			req->canceled = true;
+		} else if (op->kind == REQUEST_OP_PRIORITIZE) {
+			wake = wake || op->priority > req->priority;
+			req->priority = op->priority;
+		}
+	}
+
+	UNLOCK(&c->_reqs_mutex);
+
+	if (wake) _client_wake(c);
+}
+
 void _client_free_cur_status(Client *c) {
 	WRITE_LOCK(&c->_status_rwlock);
 	if (c->_cur_status_nullable) {
@@ -177,8 +356,26 @@ void _client_set_cur_status(Client *c, struct mpd_status *status) {
 	if (c->_cur_status_nullable)
 		mpd_status_free(c->_cur_status_nullable);
 	c->_cur_status_nullable = status;
+	c->_cur_status_time_ms = monotonic_ms();
 	RW_UNLOCK(&c->_status_rwlock);
 }
+
+unsigned client_elapsed_ms(Client *c) {
+	const struct mpd_status *status = c->_cur_status_nullable;
+	if (!status) return 0;
+
+	unsigned elapsed = mpd_status_get_elapsed_ms(status);
+	if (mpd_status_get_state(status) != MPD_STATE_PLAY) return elapsed;
+
+	elapsed += (unsigned)(monotonic_ms() - c->_cur_status_time_ms);
+
+	// Don't run past the end of the song while waiting for the next one
+	unsigned total = mpd_status_get_total_time(status) * 1000;
+	if (total > 0 && elapsed > total)
+		elapsed = total;
+
+	return elapsed;
+}
 void _client_set_cur_song(Client *c, struct mpd_song *song) {
 	WRITE_LOCK(&c->_status_rwlock);
 	if (c->_cur_song_nullable)
@@ -258,53 +455,168 @@ static int readpicture(
 	return size;
 }
 
-typedef struct DecodeArtworkArgs {
-	Client *client;
-	const char *filetype;
-	unsigned char *buffer;
-	int buffer_size;
-
-	int req_id;
-} DecodeArtworkArgs;
-
-static void *_decode_artwork(void *args_) {
-	DecodeArtworkArgs *args = args_;
-	Client *c = args->client;
-
-	Image image = LoadImageFromMemory(
-		args->filetype,
-		args->buffer,
-		args->buffer_size
-	);
-
-	Color color = image_average_color(image);
-
+static void _client_push_artwork_response(
+	Client *c,
+	int req_id,
+	uint64_t key,
+	int size,
+	Image image,
+	Color color
+) {
 	_client_push_event(c, (Event){
 		.kind = EVENT_RESPONSE,
 		.data = {
 			.response_artwork = {
-				.id = args->req_id,
+				.id = req_id,
+				.key = key,
+				.size = size,
 				.image = image,
 				.color = color,
 			}
 		}
 	});
+}
 
-	free(args->buffer);
-	free(args);
-	return NULL;
+static bool _client_is_request_canceled(Client *c, int id) {
+	LOCK(&c->_reqs_mutex);
+
+	Request *req = NULL;
+	HASH_FIND_INT(c->_reqs, &id, req);
+	bool canceled = req == NULL || req->canceled;
+
+	UNLOCK(&c->_reqs_mutex);
+	return canceled;
+}
+
+// Free request that was handed over to the decode pool
+static void _client_finish_request(Client *c, int id) {
+	LOCK(&c->_reqs_mutex);
+
+	Request *req = NULL;
+	HASH_FIND_INT(c->_reqs, &id, req);
+	if (req) {
+		assert(req->state == REQUEST_DECODING || req->state == REQUEST_LOOKUP);
+		_client_free_request(c, req);
+	}
+
+	UNLOCK(&c->_reqs_mutex);
+}
+
+// Serve the request from the disk cache, or give it back to the client
+// thread to download the artwork
+// Runs on a decode pool worker thread, so cache hits never wait for
+// the MPD connection
+static void _client_lookup_artwork(Client *c, DecodeJob job) {
+	if (_client_is_request_canceled(c, job.req_id)) {
+		_client_finish_request(c, job.req_id);
+		return;
+	}
+
+	Image image;
+	Color color;
+	if (artwork_cache_load(job.key, job.size, &image, &color)) {
+		TraceLog(LOG_INFO, "MPD CLIENT: Request %d was served from the artwork cache", job.req_id);
+		_client_push_artwork_response(c, job.req_id, job.key, job.size, image, color);
+		_client_finish_request(c, job.req_id);
+	} else {
+		LOCK(&c->_reqs_mutex);
+
+		Request *req = NULL;
+		HASH_FIND_INT(c->_reqs, &job.req_id, req);
+		if (req) {
+			assert(req->state == REQUEST_LOOKUP);
+			req->state = REQUEST_PENDING;
+			req->cache_missed = true;
+		}
+
+		UNLOCK(&c->_reqs_mutex);
+	}
+
+	// There is a free slot in the decode pool now, and maybe a request to
+	// download
+	_client_wake(c);
+}
+
+// Runs on a decode pool worker thread
+static void _client_decode_artwork(void *client, DecodeJob job) {
+	Client *c = client;
+
+	if (job.buffer == NULL) {
+		_client_lookup_artwork(c, job);
+		return;
+	}
+
+	// Don't waste time decoding artworks nobody is waiting for anymore
+	if (_client_is_request_canceled(c, job.req_id)) {
+		free(job.buffer);
+		goto defer;
+	}
+
+	TraceTimer timer = trace_begin(TRACE_DECODE);
+
+	Image image = LoadImageFromMemory(
+		job.filetype,
+		job.buffer,
+		job.buffer_size
+	);
+	free(job.buffer);
+
+	if (image.data == NULL) {
+		TraceLog(LOG_WARNING, "MPD CLIENT: Unable to decode artwork of request %d", job.req_id);
+		goto defer;
+	}
+
+	// Shrink the full-size image right away, so only the thumbnail outlives
+	// this function
+	ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+	image_fit(&image, ARTWORK_MAX_SIZE);
+
+	// Average color is calculated from the largest level, so it is the same
+	// no matter which level is displayed
+	Color color = image_average_color(image);
+
+	// Save the largest level, so any other level can be generated from it
+	// later without downloading the artwork again. Save it even if the
+	// request was canceled in the meantime, the work is already done.
+	artwork_cache_save(job.key, ARTWORK_MAX_SIZE, image, color);
+
+	if (job.size < ARTWORK_MAX_SIZE) {
+		image_fit(&image, job.size);
+		artwork_cache_save(job.key, job.size, image, color);
+	}
+
+	trace_end(timer);
+
+	if (_client_is_request_canceled(c, job.req_id))
+		UnloadImage(image);
+	else
+		_client_push_artwork_response(c, job.req_id, job.key, job.size, image, color);
+
+defer:
+	_client_finish_request(c, job.req_id);
+
+	// There is a free slot in the decode pool now
+	_client_wake(c);
 }
 
-// Returns whether artwork was successfully fetched
-bool _client_fetch_song_artwork(Client *c, const Request *req) {
+// Download artwork of the request, it was already looked up in the disk
+// cache (see `_client_lookup_artwork()`)
+// Must be called without `_reqs_mutex` locked, request fields used here
+// are never changed after the request is made
+// Returns whether the artwork was downloaded and must be decoded, assigns
+// `job` in that case
+static bool _client_fetch_song_artwork(Client *c, const Request *req, DecodeJob *job) {
 	assert(req != NULL);
 	assert(req->id > 0);
-	assert(!req->canceled);
+	assert(req->state == REQUEST_FETCHING);
+	assert(req->cache_missed);
 
 	size_t capacity = 1024 * 256; // 256KB
 	unsigned char *buffer = malloc(capacity);
 	char filetype[16] = {0};
+	TraceTimer timer = trace_begin(TRACE_READPICTURE);
 	int size = readpicture(c, &buffer, capacity, &filetype, req->song_uri);
+	trace_end(timer);
 
 	// Simply return if there is an error or no artwork
 	if (size <= 0) {
@@ -328,15 +640,15 @@ bool _client_fetch_song_artwork(Client *c, const Request *req) {
 		goto nope;
 	}
 
-	DecodeArtworkArgs *args = malloc(sizeof(DecodeArtworkArgs));
-	args->client = c;
-	args->buffer = buffer;
-	args->buffer_size = size;
-	args->filetype = img_filetype;
-	args->req_id = req->id;
-
-	pthread_t thread;
-	pthread_create(&thread, NULL, _decode_artwork, args);
+	*job = (DecodeJob){
+		.req_id = req->id,
+		.key = req->key,
+		.size = req->size,
+		.priority = req->priority,
+		.filetype = img_filetype,
+		.buffer = buffer,
+		.buffer_size = size,
+	};
 	return true;
 
 nope:
@@ -344,7 +656,9 @@ nope:
 }
 
 struct mpd_status *_client_fetch_status(Client *c) {
+	TraceTimer timer = trace_begin(TRACE_STATUS_FETCH);
 	struct mpd_status *status = mpd_run_status(c->_conn);
+	trace_end(timer);
 	if (!status) {
 		_client_free_cur_status(c);
 		return NULL;
@@ -352,7 +666,7 @@ struct mpd_status *_client_fetch_status(Client *c) {
 
 	_client_set_cur_status(c, status);
 	// Reset fetch timer so we don't fetch status twice if timer is finished
-	c->_status_fetch_timer = STATUS_FETCH_INTERVAL_MS;
+	c->_status_fetch_timer = STATUS_RESYNC_INTERVAL_MS;
 	return status;
 }
 // Fetch playback status and currently playing song
@@ -390,41 +704,249 @@ bool _client_fetch_status_and_song(Client *c) {
 	return changed;
 }
 
-void _client_fetch_queue(Client *c) {
-	clock_t start = clock();
+static void _queue_changes_free(EventDataQueue *changes) {
+	for (size_t i = 0; i < changes->len; i++) {
+		if (changes->items[i].entity_nullable)
+			mpd_entity_free(changes->items[i].entity_nullable);
+	}
+	free(changes->items);
+	*changes = (EventDataQueue){0};
+}
 
-	bool res = mpd_send_list_queue_meta(c->_conn);
-	if (!res) {
-		CONN_HANDLE_ERROR(c->_conn);
-		return;
+// Receive the queue changes since `_queue_version`
+// Status is requested in the same command list, so `version` always matches
+// the changes.
+// If `meta` is `true`, changes come with the song entities (`plchanges`),
+// otherwise only with positions and ids (`plchangesposid`).
+static bool _client_recv_queue_changes(
+	Client *c,
+	bool meta,
+	EventDataQueue *changes,
+	unsigned *version
+) {
+	struct mpd_connection *conn = c->_conn;
+
+	bool res = mpd_command_list_begin(conn, true)
+		&& mpd_send_status(conn)
+		&& (meta
+			? mpd_send_queue_changes_meta(conn, c->_queue_version)
+			: mpd_send_queue_changes_brief(conn, c->_queue_version))
+		&& mpd_command_list_end(conn);
+	if (!res) goto error;
+
+	struct mpd_status *status = mpd_recv_status(conn);
+	if (!status) goto error;
+
+	*version = mpd_status_get_queue_version(status);
+	*changes = (EventDataQueue){ .queue_len = mpd_status_get_queue_length(status) };
+	mpd_status_free(status);
+
+	if (!mpd_response_next(conn)) goto error;
+
+	if (meta) {
+		struct mpd_entity *entity;
+		while ((entity = mpd_recv_entity(conn)) != NULL) {
+			if (mpd_entity_get_type(entity) != MPD_ENTITY_TYPE_SONG) {
+				mpd_entity_free(entity);
+				continue;
+			}
+
+			const struct mpd_song *song = mpd_entity_get_song(entity);
+			DA_PUSH(changes, ((QueueChange){
+				.pos = mpd_song_get_pos(song),
+				.id = mpd_song_get_id(song),
+				.entity_nullable = entity,
+			}));
+		}
+	} else {
+		unsigned pos, id;
+		while (mpd_recv_queue_change_brief(conn, &pos, &id))
+			DA_PUSH(changes, ((QueueChange){ .pos = pos, .id = id }));
 	}
 
-	EventDataQueue queue = {0};
+	if (!mpd_response_finish(conn)) {
+		_queue_changes_free(changes);
+		goto error;
+	}
 
-	DA_RESERVE(&queue, 512);
+	return true;
 
-	// Receive queue entities/songs from the server
-	while (true) {
-		struct mpd_entity *entity = mpd_recv_entity(c->_conn);
-		if (entity == NULL) {
-			CONN_HANDLE_ERROR(c->_conn);
-			break;
+error:
+	CONN_HANDLE_ERROR(conn);
+	return false;
+}
+
+// Fetch entities of the changed songs the UI doesn't have yet
+// Returns `false` if it failed, for example when the queue was changed
+// again and some of the songs are already gone
+static bool _client_fetch_unknown_songs(Client *c, EventDataQueue *changes) {
+	struct mpd_connection *conn = c->_conn;
+
+	size_t unknown = 0;
+	for (size_t i = 0; i < changes->len; i++) {
+		QueueSongId *known = NULL;
+		HASH_FIND_INT(c->_queue_ids_set, &changes->items[i].id, known);
+		if (!known) unknown += 1;
+	}
+
+	if (unknown == 0) return true;
+	// It is cheaper to just refetch the whole diff at this point
+	if (unknown > QUEUE_SYNC_MAX_SONG_QUERIES || unknown * 2 > changes->len) return false;
+
+	if (!mpd_command_list_begin(conn, true)) goto error;
+	for (size_t i = 0; i < changes->len; i++) {
+		QueueSongId *known = NULL;
+		HASH_FIND_INT(c->_queue_ids_set, &changes->items[i].id, known);
+		if (known) continue;
+
+		if (!mpd_send_get_queue_song_id(conn, changes->items[i].id)) goto error;
+	}
+	if (!mpd_command_list_end(conn)) goto error;
+
+	// Responses come in the same order as the commands
+	for (size_t i = 0; i < changes->len; i++) {
+		QueueChange *change = &changes->items[i];
+
+		QueueSongId *known = NULL;
+		HASH_FIND_INT(c->_queue_ids_set, &change->id, known);
+		if (known) continue;
+
+		change->entity_nullable = mpd_recv_entity(conn);
+		if (!change->entity_nullable) goto error;
+		if (!mpd_response_next(conn)) goto error;
+	}
+
+	if (!mpd_response_finish(conn)) goto error;
+	return true;
+
+error:
+	CONN_HANDLE_ERROR(conn);
+	for (size_t i = 0; i < changes->len; i++) {
+		if (changes->items[i].entity_nullable) {
+			mpd_entity_free(changes->items[i].entity_nullable);
+			changes->items[i].entity_nullable = NULL;
 		}
+	}
+	return false;
+}
 
-		enum mpd_entity_type typ = mpd_entity_get_type(entity);
-		if (typ == MPD_ENTITY_TYPE_SONG)
-			DA_PUSH(&queue, entity);
+static void _client_forget_queue(Client *c) {
+	QueueSongId *entry, *tmp;
+	HASH_ITER(hh, c->_queue_ids_set, entry, tmp) {
+		HASH_DEL(c->_queue_ids_set, entry);
+		free(entry);
 	}
 
-	clock_t end = clock();
-	int time = (int)((double)(end - start) / CLOCKS_PER_SEC * 1000);
-	TraceLog(LOG_INFO, "MPD CLIENT: QUEUE: Updated in %dms (%d songs)", time, queue.len);
+	c->_queue_ids.len = 0;
+	c->_queue_version = 0;
+}
 
-	// Push event
-	_client_push_event(c, (Event){
+// Apply changes to the mirror of the UI queue
+static void _client_apply_queue_changes(Client *c, EventDataQueue changes) {
+	// Forget songs that left their positions, the ones that were only moved
+	// are added back below
+	QueueSongId *entry = NULL;
+	for (size_t i = 0; i < changes.len; i++) {
+		unsigned pos = changes.items[i].pos;
+		if (pos >= c->_queue_ids.len) continue;
+
+		HASH_FIND_INT(c->_queue_ids_set, &c->_queue_ids.items[pos], entry);
+		if (entry) {
+			HASH_DEL(c->_queue_ids_set, entry);
+			free(entry);
+		}
+	}
+	for (size_t pos = changes.queue_len; pos < c->_queue_ids.len; pos++) {
+		HASH_FIND_INT(c->_queue_ids_set, &c->_queue_ids.items[pos], entry);
+		if (entry) {
+			HASH_DEL(c->_queue_ids_set, entry);
+			free(entry);
+		}
+	}
+
+	DA_RESERVE(&c->_queue_ids, changes.queue_len);
+	c->_queue_ids.len = changes.queue_len;
+
+	for (size_t i = 0; i < changes.len; i++) {
+		QueueChange change = changes.items[i];
+		c->_queue_ids.items[change.pos] = change.id;
+
+		HASH_FIND_INT(c->_queue_ids_set, &change.id, entry);
+		if (!entry) {
+			entry = malloc(sizeof(QueueSongId));
+			entry->id = change.id;
+			HASH_ADD_INT(c->_queue_ids_set, id, entry);
+		}
+	}
+}
+
+// Send the queue changes since the last sync to the UI
+void _client_sync_queue(Client *c) {
+	TraceTimer timer = trace_begin(TRACE_QUEUE_FETCH);
+
+	c->_queue_resync = false;
+
+	EventDataQueue changes;
+	unsigned version;
+	bool meta = false;
+
+	// UI has nothing yet, so every song has to be fetched anyway
+	if (c->_queue_ids.len == 0) {
+		meta = true;
+		if (!_client_recv_queue_changes(c, true, &changes, &version)) return;
+	} else {
+		if (!_client_recv_queue_changes(c, false, &changes, &version)) return;
+
+		if (!_client_fetch_unknown_songs(c, &changes)) {
+			_queue_changes_free(&changes);
+
+			meta = true;
+			if (!_client_recv_queue_changes(c, true, &changes, &version)) return;
+		}
+	}
+
+	// Changes may come with positions that were removed right after
+	// `status` in the same command list, there is nothing to apply them to
+	size_t len = 0;
+	for (size_t i = 0; i < changes.len; i++) {
+		if (changes.items[i].pos < changes.queue_len) {
+			changes.items[len++] = changes.items[i];
+		} else if (changes.items[i].entity_nullable) {
+			mpd_entity_free(changes.items[i].entity_nullable);
+		}
+	}
+	changes.len = len;
+
+	c->_queue_version = version;
+
+	if (changes.len == 0 && changes.queue_len == c->_queue_ids.len) {
+		_queue_changes_free(&changes);
+		return;
+	}
+
+	_client_apply_queue_changes(c, changes);
+
+	int time = (int)trace_end(timer);
+	TraceLog(
+		LOG_INFO,
+		"MPD CLIENT: QUEUE: Synced in %dms (%d songs, %d changed, %s)",
+		time,
+		changes.queue_len,
+		changes.len,
+		meta ? "plchanges" : "plchangesposid"
+	);
+
+	bool pushed = _client_push_event(c, (Event){
 		.kind = EVENT_QUEUE_CHANGED,
-		.data = { .queue = queue }
+		.data = { .queue = changes }
 	});
+
+	if (!pushed) {
+		// UI didn't get the changes, so the mirror doesn't match it anymore
+		TraceLog(LOG_WARNING, "MPD CLIENT: QUEUE: Changes were dropped, resyncing the whole queue");
+		_client_forget_queue(c);
+		c->_queue_resync = true;
+	}
 }
 
 static int _items_sort_func(const void* a, const void* b) {
@@ -432,22 +954,148 @@ static int _items_sort_func(const void* a, const void* b) {
 	const AlbumInfo *bi = b;
 	return strcmp(ai->title, bi->title);
 }
-void _client_fetch_albums(Client *c) {
-	clock_t start = clock();
 
-	// TODO: also group by the "disk" tag
+// Album that was already added to the list
+typedef struct SeenAlbum {
+	// Owned "<album>\x1f<artist>" string
+	char *key;
+	UT_hash_handle hh; // to make struct hashable
+} SeenAlbum;
+
+// Add album of the song unless it is already in the list
+// Takes the ownership of the strings
+static void _albums_add_song(
+	EventDataAlbumsList *albums,
+	SeenAlbum **seen,
+	char *file,
+	char *album,
+	char *artist_nullable
+) {
+	if (!file || !album || album[0] == '\0') goto free;
+
+	const char *artist = artist_nullable ? artist_nullable : "";
+	size_t key_len = strlen(album) + 1 + strlen(artist);
+	char *key = malloc(key_len + 1);
+	snprintf(key, key_len + 1, "%s\x1f%s", album, artist);
+
+	SeenAlbum *entry = NULL;
+	HASH_FIND(hh, *seen, key, key_len, entry);
+	if (entry) {
+		free(key);
+		goto free;
+	}
+
+	entry = malloc(sizeof(SeenAlbum));
+	entry->key = key;
+	HASH_ADD_KEYPTR(hh, *seen, entry->key, key_len, entry);
+
+	// The first song of the album becomes its artwork source
+	DA_PUSH(albums, ((AlbumInfo){
+		.title = album,
+		.artist_nullable = artist_nullable,
+		.first_song_uri_nullable = file,
+	}));
+	return;
+
+free:
+	free(file);
+	free(album);
+	free(artist_nullable);
+}
+
+// Receive one page of `find` results
+// Returns number of the received songs or -1 on error
+static int _client_recv_albums_page(
+	Client *c,
+	unsigned start,
+	EventDataAlbumsList *albums,
+	SeenAlbum **seen
+) {
+	if (false
+		|| !mpd_search_db_songs(c->_conn, true)
+		|| !mpd_search_add_expression(c->_conn, "(Album != \"\")")
+		|| !mpd_search_add_window(c->_conn, start, start + ALBUMS_FETCH_PAGE_SIZE)
+		|| !mpd_search_commit(c->_conn)
+	) {
+		CONN_HANDLE_ERROR(c->_conn);
+		return -1;
+	}
+
+	int songs = 0;
+	char *file = NULL;
+	char *album = NULL;
+	char *artist = NULL;
+
+	// Song attributes are streamed as pairs, every song starts with "file"
+	while (true) {
+		struct mpd_pair *pair = mpd_recv_pair(c->_conn);
+
+		if (!pair || strcmp(pair->name, "file") == 0) {
+			_albums_add_song(albums, seen, file, album, artist);
+			file = album = artist = NULL;
+		}
+		if (!pair) break;
+
+		if (strcmp(pair->name, "file") == 0) {
+			file = strdup(pair->value);
+			songs += 1;
+		} else if (strcmp(pair->name, "Album") == 0 && !album) {
+			album = strdup(pair->value);
+		} else if (strcmp(pair->name, "Artist") == 0 && !artist) {
+			artist = strdup(pair->value);
+		}
+
+		mpd_return_pair(c->_conn, pair);
+	}
+
+	if (!mpd_response_finish(c->_conn)) {
+		CONN_HANDLE_ERROR(c->_conn);
+		return -1;
+	}
+
+	return songs;
+}
+
+// Collect albums and their first songs in a single pass over all the songs
+// with an album tag.
+// Songs are received in pages, so a large library doesn't overflow MPD
+// output buffer (`max_output_buffer_size`).
+// Returns number of the made requests
+static int _client_scan_albums(Client *c, EventDataAlbumsList *albums, unsigned *songs) {
+	SeenAlbum *seen = NULL;
+
+	*songs = 0;
+	int requests = 0;
+	while (true) {
+		int received = _client_recv_albums_page(c, *songs, albums, &seen);
+		requests += 1;
+
+		if (received < 0) break;
+		*songs += received;
+		if (received < ALBUMS_FETCH_PAGE_SIZE) break;
+	}
+
+	SeenAlbum *entry, *tmp;
+	HASH_ITER(hh, seen, entry, tmp) {
+		HASH_DEL(seen, entry);
+		free(entry->key);
+		free(entry);
+	}
+
+	return requests;
+}
+
+// Collect all albums and their artists
+static bool _client_list_albums(Client *c, EventDataAlbumsList *albums) {
 	if (false
 		|| !mpd_search_db_tags(c->_conn, MPD_TAG_ALBUM)
 		|| !mpd_search_add_group_tag(c->_conn, MPD_TAG_ARTIST)
 		|| !mpd_search_commit(c->_conn)
 	) {
 		CONN_HANDLE_ERROR(c->_conn);
-		return;
+		return false;
 	}
 
-	EventDataAlbumsList albums = {0};
-
-	// Collect all albums and their artists
 	char *cur_artist = NULL;
 	while (true) {
 		struct mpd_pair *pair = mpd_recv_pair(c->_conn);
@@ -455,7 +1103,7 @@ void _client_fetch_albums(Client *c) {
 
 		if (strcmp(pair->name, "Artist") == 0) {
 			free(cur_artist);
-			cur_artist = strdup(pair->value);
+			cur_artist = pair->value[0] != '\0' ? strdup(pair->value) : NULL;
 		}
 
 		if (strcmp(pair->name, "Album") == 0 && strlen(pair->value) > 0) {
@@ -464,57 +1112,120 @@ void _client_fetch_albums(Client *c) {
 				.artist_nullable = cur_artist ? strdup(cur_artist) : NULL,
 				.first_song_uri_nullable = NULL,
 			};
-			DA_PUSH(&albums, info);
+			DA_PUSH(albums, info);
 		}
 
 		mpd_return_pair(c->_conn, pair);
 	}
 	free(cur_artist);
 
-	qsort(albums.items, albums.len, sizeof(albums.items[0]), _items_sort_func);
-
 	if (!mpd_response_finish(c->_conn)) {
 		CONN_HANDLE_ERROR(c->_conn);
-		return;
+		return false;
 	}
 
-	// Fetch first song of each album
-	for (size_t i = 0; i < albums.len; i++) {
-		AlbumInfo *info = &albums.items[i];
+	return true;
+}
 
-		if (false
-			|| !mpd_search_db_songs(c->_conn, true)
-			|| !mpd_search_add_tag_constraint(c->_conn, MPD_OPERATOR_DEFAULT, MPD_TAG_ALBUM, info->title)
-			|| !mpd_search_add_window(c->_conn, 0, 1)
-			|| !mpd_search_commit(c->_conn)
-		) {
-			CONN_HANDLE_ERROR(c->_conn);
-			continue;
+// Look up the first song of each album, `batch_size` lookups are sent at
+// once in a command list, so the latency is paid once per batch.
+// Responses are parsed as they arrive.
+// Returns number of the made requests
+static int _client_lookup_first_songs(Client *c, EventDataAlbumsList *albums, int batch_size) {
+	struct mpd_connection *conn = c->_conn;
+
+	int requests = 0;
+	for (size_t batch = 0; batch < albums->len; batch += batch_size) {
+		size_t batch_end = MIN(batch + (size_t)batch_size, albums->len);
+		requests += 1;
+
+		if (!mpd_command_list_begin(conn, true)) goto error;
+
+		for (size_t i = batch; i < batch_end; i++) {
+			AlbumInfo *info = &albums->items[i];
+
+			bool res = mpd_search_db_songs(conn, true)
+				&& mpd_search_add_tag_constraint(conn, MPD_OPERATOR_DEFAULT, MPD_TAG_ALBUM, info->title)
+				&& (!info->artist_nullable
+					|| mpd_search_add_tag_constraint(conn, MPD_OPERATOR_DEFAULT, MPD_TAG_ARTIST, info->artist_nullable))
+				&& mpd_search_add_window(conn, 0, 1)
+				&& mpd_search_commit(conn);
+
+			if (!res) {
+				mpd_search_cancel(conn);
+				goto error;
+			}
 		}
 
-		// Receive info for the first song in the album
-		{
-			struct mpd_pair *pair = mpd_recv_pair_named(c->_conn, "file");
-			if (!pair) continue;
+		if (!mpd_command_list_end(conn)) goto error;
 
-			info->first_song_uri_nullable = strdup(pair->value);
+		// Every lookup response ends with "list_OK"
+		for (size_t i = batch; i < batch_end; i++) {
+			AlbumInfo *info = &albums->items[i];
 
-			mpd_return_pair(c->_conn, pair);
+			struct mpd_pair *pair;
+			while ((pair = mpd_recv_pair(conn)) != NULL) {
+				if (strcmp(pair->name, "file") == 0 && !info->first_song_uri_nullable)
+					info->first_song_uri_nullable = strdup(pair->value);
+
+				mpd_return_pair(conn, pair);
+			}
+
+			if (!mpd_response_next(conn)) goto error;
 		}
 
-		if (!mpd_response_finish(c->_conn))
-			CONN_HANDLE_ERROR(c->_conn);
+		if (!mpd_response_finish(conn)) goto error;
 	}
 
-	clock_t end = clock();
-	int time = (int)((double)(end - start) / CLOCKS_PER_SEC * 1000);
-	TraceLog(LOG_INFO, "MPD CLIENT: ALBUMS LIST: Updated in %dms (%d albums)", time, albums.len);
+	return requests;
+
+error:
+	CONN_HANDLE_ERROR(conn);
+	return requests;
+}
+
+void _client_fetch_albums(Client *c) {
+	TraceTimer timer = trace_begin(TRACE_ALBUMS_FETCH);
+
+	EventDataAlbumsList albums = {0};
+	unsigned songs = 0;
+	int requests;
+
+	// TODO: also group by the "disk" tag
+	if (c->_albums_batch_size > 0) {
+		// Transfers only album names and one song per album, which is much
+		// less than all the songs for a remote server
+		requests = 1;
+		if (_client_list_albums(c, &albums))
+			requests += _client_lookup_first_songs(c, &albums, c->_albums_batch_size);
+	} else {
+		requests = _client_scan_albums(c, &albums, &songs);
+	}
+
+	qsort(albums.items, albums.len, sizeof(albums.items[0]), _items_sort_func);
+
+	int time = (int)trace_end(timer);
+	TraceLog(
+		LOG_INFO,
+		"MPD CLIENT: ALBUMS LIST: Updated in %dms (%d albums, %d requests, %s)",
+		time,
+		albums.len,
+		requests,
+		c->_albums_batch_size > 0 ? "batched lookups" : "single pass"
+	);
+
+	c->_albums_resync = false;
 
 	// Push event
-	_client_push_event(c, (Event){
+	bool pushed = _client_push_event(c, (Event){
 		.kind = EVENT_ALBUMS_LIST_CHANGED,
 		.data = { .albums = albums },
 	});
+
+	if (!pushed) {
+		TraceLog(LOG_WARNING, "MPD CLIENT: ALBUMS LIST: List was dropped, fetching it again");
+		c->_albums_resync = true;
+	}
 }
 
 bool _conn_run_toggle(struct mpd_connection *conn) {
@@ -546,8 +1257,9 @@ bool _client_recv_idle(Client *c, enum mpd_idle *idle) {
 
 		if (strcmp(line, "OK") == 0) break;
 
-		if (strcmp(line, "changed: player") == 0)   *idle |= MPD_IDLE_PLAYER;
-		if (strcmp(line, "changed: playlist") == 0) *idle |= MPD_IDLE_PLAYLIST;
+		const char *prefix = "changed: ";
+		if (strncmp(line, prefix, strlen(prefix)) == 0)
+			*idle |= mpd_idle_name_parse(line + strlen(prefix));
 	}
 
 	if (!mpd_response_finish(c->_conn)) {
@@ -558,21 +1270,51 @@ bool _client_recv_idle(Client *c, enum mpd_idle *idle) {
 	return true;
 }
 
-void _client_poll_idle(Client *c, enum mpd_idle *idle) {
-	struct mpd_async *async = mpd_connection_get_async(c->_conn);
+// Block until the MPD socket is readable, the client is woken up by
+// `_client_wake()` or `timeout_ms` has passed (-1 - no timeout)
+// Returns whether the MPD socket is readable
+static bool _client_wait(Client *c, int timeout_ms) {
+	struct pollfd fds[2] = {
+		{ .fd = mpd_connection_get_fd(c->_conn), .events = POLLIN },
+		{ .fd = c->_wake_fds[0], .events = POLLIN },
+	};
 
-	if (c->_polling_idle) {
-		if (_client_recv_idle(c, idle))
-			c->_polling_idle = false;
-	} else {
-		if (!mpd_async_send_command(async, "idle", NULL)) {
-			ASYNC_HANDLE_ERROR(async);
-			return;
-		}
+	int res = poll(fds, 2, timeout_ms);
+	if (res < 0) {
+		if (errno != EINTR)
+			TraceLog(LOG_ERROR, "MPD CLIENT: poll() failed: %s", strerror(errno));
+		return false;
+	}
+
+	// Drain the wake pipe, all the wakeups are handled at once
+	if (fds[1].revents & POLLIN) {
+		char buf[64];
+		while (read(c->_wake_fds[0], buf, sizeof(buf)) > 0);
+	}
 
-		assert(mpd_async_io(async, MPD_ASYNC_EVENT_WRITE));
-		c->_polling_idle = true;
+	return (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+}
+
+// Block until the MPD socket is readable
+static void _client_wait_for_server(Client *c) {
+	struct pollfd fd = { .fd = mpd_connection_get_fd(c->_conn), .events = POLLIN };
+	while (poll(&fd, 1, -1) < 0 && errno == EINTR);
+}
+
+// Enter the idle mode, so the server notifies about changes
+// Received changes are handled by `_client_recv_idle()`
+void _client_poll_idle(Client *c) {
+	if (c->_polling_idle) return;
+
+	struct mpd_async *async = mpd_connection_get_async(c->_conn);
+
+	if (!mpd_async_send_command(async, "idle", NULL)) {
+		ASYNC_HANDLE_ERROR(async);
+		return;
 	}
+
+	assert(mpd_async_io(async, MPD_ASYNC_EVENT_WRITE));
+	c->_polling_idle = true;
 }
 void _client_noidle(Client *c, enum mpd_idle *idle) {
 	if (!c->_polling_idle) return;
@@ -587,14 +1329,16 @@ void _client_noidle(Client *c, enum mpd_idle *idle) {
 
 	assert(mpd_async_io(async, MPD_ASYNC_EVENT_WRITE));
 
-	// Sleep untill we receive all data from `noidle`
-	while (!_client_recv_idle(c, idle));
+	// Wait untill we receive all data from `noidle`
+	while (!_client_recv_idle(c, idle))
+		_client_wait_for_server(c);
 	c->_polling_idle = false;
 }
 
 static void _client_handle_action(Client *c, Action action) {
 	if (action.kind <= 0) return;
 
+	TraceTimer timer = trace_begin(TRACE_HANDLE_ACTION);
 	struct mpd_connection *conn = c->_conn;
 
 	bool res = 0;
@@ -628,8 +1372,9 @@ static void _client_handle_action(Client *c, Action action) {
 			break;
 
 		case ACTION_REORDER_QUEUE:
+			// Queue page has already reordered its items, the changes will
+			// arrive with the next `MPD_IDLE_QUEUE` and won't move anything
 			res = mpd_run_move(conn, action.data.reorder.from, action.data.reorder.to);
-			if (res) c->_queue_changed_inside_mupwit = true;
 			break;
 
 		case ACTION_CLOSE:
@@ -639,6 +1384,79 @@ static void _client_handle_action(Client *c, Action action) {
 
 	if (!res)
 		CONN_HANDLE_ERROR(conn);
+
+	trace_end(timer);
+}
+
+// Subsystems which are expensive to refetch
+#define IDLE_COALESCED (MPD_IDLE_QUEUE | MPD_IDLE_DATABASE)
+
+static unsigned _idle_count(enum mpd_idle idle) {
+	unsigned count = 0;
+	if (idle & MPD_IDLE_QUEUE)    count += 1;
+	if (idle & MPD_IDLE_DATABASE) count += 1;
+	return count;
+}
+
+// Whether the pending changes must be handled now
+static bool _client_pending_idle_ready(Client *c) {
+	if (c->_pending_idle == 0) return false;
+	return c->_pending_idle_timer <= 0 || c->_pending_idle_deadline <= 0;
+}
+
+// Time left until the pending changes must be handled
+// Returns -1 if nothing is pending
+static int _client_pending_idle_timeout(Client *c) {
+	if (c->_pending_idle == 0) return -1;
+	return MAX(MIN(c->_pending_idle_timer, c->_pending_idle_deadline), 0);
+}
+
+// Delay changes of the expensive subsystems until no more changes arrive
+// during the debounce window
+// Returns the changes that must be handled right now
+static enum mpd_idle _client_coalesce_idle(Client *c, enum mpd_idle idle) {
+	enum mpd_idle coalesced = idle & IDLE_COALESCED;
+	idle &= ~IDLE_COALESCED;
+
+	if (coalesced) {
+		if (c->_pending_idle == 0)
+			c->_pending_idle_deadline = c->_idle_debounce_ms * IDLE_DEBOUNCE_MAX_WINDOWS;
+
+		// Every new change restarts the window
+		c->_pending_idle |= coalesced;
+		c->_pending_idle_timer = c->_idle_debounce_ms;
+
+		WRITE_LOCK(&c->_state_rwlock);
+		c->_idle_stats.received += _idle_count(coalesced);
+		RW_UNLOCK(&c->_state_rwlock);
+	}
+
+	if (_client_pending_idle_ready(c)) {
+		idle |= c->_pending_idle;
+
+		WRITE_LOCK(&c->_state_rwlock);
+		c->_idle_stats.fetched += _idle_count(c->_pending_idle);
+		RW_UNLOCK(&c->_state_rwlock);
+
+		c->_pending_idle = 0;
+	}
+
+	return idle;
+}
+
+ClientIdleStats client_get_idle_stats(Client *c) {
+	READ_LOCK(&c->_state_rwlock);
+	ClientIdleStats stats = c->_idle_stats;
+	RW_UNLOCK(&c->_state_rwlock);
+	return stats;
+}
+
+ClientEventStats client_get_event_stats(Client *c) {
+	return (ClientEventStats){
+		.coalesced = atomic_load(&c->_events_coalesced),
+		.blocked = atomic_load(&c->_events_blocked),
+		.dropped = atomic_load(&c->_events_dropped),
+	};
 }
 
 static void _client_handle_idle(Client *c, enum mpd_idle idle) {
@@ -650,66 +1468,173 @@ static void _client_handle_idle(Client *c, enum mpd_idle idle) {
 			_client_push_event(c, (Event){.kind = EVENT_SONG_CHANGED});
 	}
 
-	if (idle & MPD_IDLE_QUEUE) {
-		if (c->_queue_changed_inside_mupwit) {
-			c->_queue_changed_inside_mupwit = false;
-		} else {
-			// Fetch queue if it was changed outside MUPWIT
-
-			// TODO: `_client_fetch_queue` being called multiple times if you
-			// do multiple queue operations simultaneously.
-			// For example: `mpc clear && mpc listall | mpc add && mpc shuffle`.
-			// This command triggers 3 MPD_IDLE_QUEUE events.
-			// May be i should add a delay between receiving MPD_IDLE_QUEUE and
-			// fetching the queue? Or may be i don't care?
-			_client_fetch_queue(c);
-		}
+	// NOTE: multiple queue operations in a row (for example
+	// `mpc clear && mpc listall | mpc add && mpc shuffle`) are coalesced
+	// into a single sync by `_client_coalesce_idle()`.
+	// Resync is delayed if the connection is in the idle mode.
+	if (idle & MPD_IDLE_QUEUE || (c->_queue_resync && !c->_polling_idle)) {
+		_client_sync_queue(c);
 	}
 
-	if (idle & MPD_IDLE_DATABASE) {
+	if (idle & MPD_IDLE_DATABASE || (c->_albums_resync && !c->_polling_idle)) {
 		_client_fetch_albums(c);
 	}
 }
 
+// Find the most important pending request, freeing the canceled ones
+// Requests with the same priority are fetched in FIFO order
+// Requests mutex must be locked
+static Request *_client_next_request(Client *c) {
+	Request *req = NULL;
+	Request *it, *tmp;
+	HASH_ITER(hh, c->_reqs, it, tmp) {
+		if (it->state != REQUEST_PENDING) continue;
+
+		if (it->canceled) {
+			_client_free_request(c, it);
+			continue;
+		}
+
+		if (!req || it->priority > req->priority)
+			req = it;
+	}
+	return req;
+}
+
 static void _client_fetch_requests(Client *c, enum mpd_idle *idle) {
-	if (TRYLOCK(&c->_reqs_mutex) != 0) return;
+	// Pending requests are looked up in the disk cache by the decode pool
+	// first, only the misses leave the idle mode to be downloaded
+	Request *req = NULL;
+	while (true) {
+		// Don't download more artworks than the decode workers can handle
+		if (decode_pool_is_full(&c->_decode_pool)) return;
 
-	// Return if `_reqs` table is empty
-	if (!c->_reqs) goto defer;
-	if (!c->_cur_req) c->_cur_req = c->_reqs;
+		if (TRYLOCK(&c->_reqs_mutex) != 0) return;
 
-	if (!c->_cur_req->canceled) {
-		_client_noidle(c, idle);
-		_client_fetch_song_artwork(c, c->_cur_req);
+		req = _client_next_request(c);
+		if (!req) {
+			UNLOCK(&c->_reqs_mutex);
+			return;
+		}
+		if (req->cache_missed) break;
+
+		req->state = REQUEST_LOOKUP;
+		DecodeJob lookup = {
+			.req_id = req->id,
+			.key = req->key,
+			.size = req->size,
+			.priority = req->priority,
+			.filetype = NULL,
+			.buffer = NULL,
+			.buffer_size = 0,
+		};
+
+		UNLOCK(&c->_reqs_mutex);
+
+		// Only the client thread pushes jobs and the queue is not full
+		assert(decode_pool_push(&c->_decode_pool, lookup));
 	}
 
-	Request *to_free = c->_cur_req;
-	c->_cur_req = c->_cur_req->hh.next;
-	_client_free_request(c, to_free);
+	// Nobody else frees requests in the `REQUEST_FETCHING` state, so it is
+	// safe to use it without holding the mutex
+	req->state = REQUEST_FETCHING;
 
-defer:
 	UNLOCK(&c->_reqs_mutex);
+
+	_client_noidle(c, idle);
+
+	DecodeJob job;
+	bool decode = _client_fetch_song_artwork(c, req, &job);
+
+	LOCK(&c->_reqs_mutex);
+	if (decode)
+		req->state = REQUEST_DECODING;
+	else
+		_client_free_request(c, req);
+	UNLOCK(&c->_reqs_mutex);
+
+	// The request must be in the `REQUEST_DECODING` state before a worker
+	// can see it.
+	// Only the client thread pushes jobs and it checks that the queue is not
+	// full before fetching, so it can't fail.
+	if (decode)
+		assert(decode_pool_push(&c->_decode_pool, job));
 }
 
 void _client_free(Client *c) {
+	decode_pool_stop(&c->_decode_pool);
+
+	ClientIdleStats stats = client_get_idle_stats(c);
+	TraceLog(
+		LOG_INFO,
+		"MPD CLIENT: IDLE: %u changes were coalesced into %u refetches (%u saved)",
+		stats.received,
+		stats.fetched,
+		stats.received - stats.fetched
+	);
+
+	ClientEventStats event_stats = client_get_event_stats(c);
+	TraceLog(
+		LOG_INFO,
+		"MPD CLIENT: EVENTS: %u coalesced, %u waited for the UI, %u dropped",
+		event_stats.coalesced,
+		event_stats.blocked,
+		event_stats.dropped
+	);
+
 	// Free allocated memory by the client
 	mpd_connection_free(c->_conn);
 	_client_free_cur_status(c);
 	_client_free_cur_song(c);
+
+	_client_forget_queue(c);
+	free(c->_queue_ids.items);
+
+	close(c->_wake_fds[0]);
+	close(c->_wake_fds[1]);
+	close(c->_ui_wake_fds[0]);
+	close(c->_ui_wake_fds[1]);
+}
+
+// Whether there are pending requests the client can handle right now
+// Only the ones that must be downloaded from the server are counted if
+// `downloads_only`, the others are looked up without leaving the idle mode
+static bool _client_has_pending_requests(Client *c, bool downloads_only) {
+	if (decode_pool_is_full(&c->_decode_pool)) return false;
+
+	LOCK(&c->_reqs_mutex);
+
+	bool pending = false;
+	Request *req, *tmp;
+	HASH_ITER(hh, c->_reqs, req, tmp) {
+		if (req->state == REQUEST_PENDING && (req->cache_missed || !downloads_only)) {
+			pending = true;
+			break;
+		}
+	}
+
+	UNLOCK(&c->_reqs_mutex);
+	return pending;
+}
+
+// Elapsed time only drifts while playing, otherwise the server notifies
+// about status changes by itself
+static bool _client_is_playing(Client *c) {
+	// NOTE: status is only changed by the client thread, so it is safe to
+	// read it without locking
+	return c->_cur_status_nullable
+		&& mpd_status_get_state(c->_cur_status_nullable) == MPD_STATE_PLAY;
 }
 
 // Client loop
-// Runs 30 times per second in a separate thread
+// Runs in a separate thread and sleeps until the server notifies about
+// changes, the UI pushes an action or makes a request, or one of the
+// timers fires
 void _client_loop(Client *c) {
-#define SHOULD_FETCH (c->_status_fetch_timer <= 0)
-#define INTERVAL_MS (1000/30)
+#define SHOULD_FETCH (_client_is_playing(c) && c->_status_fetch_timer <= 0)
 
 	if (client_get_state(c) != CLIENT_STATE_READY) return;
 
-	// Elapsed time since previous interation
-	int elapsed = 0;
-	int poll_timer = POLL_IDLE_INTERVAL_MS;
-
 	// TODO!: come up with a mechanism to wait on main thread untill all
 	// the action are handled.
 	// Currently if you, for example, seek the current song using the progress
@@ -718,37 +1643,51 @@ void _client_loop(Client *c) {
 	// response will arrive untill the next frame and new value for
 	// the progress bar just isn't ready yet.
 
+	double prev_time = monotonic_ms();
+	bool readable = false;
+
 	while (true) {
-		clock_t start = clock();
+		TraceTimer loop_timer = trace_begin(TRACE_CLIENT_LOOP);
+
+		// Elapsed time since previous interation
+		double now = monotonic_ms();
+		int elapsed = (int)(now - prev_time);
+		prev_time += elapsed;
 
 		c->_status_fetch_timer -= elapsed;
-		poll_timer -= elapsed;
+		c->_pending_idle_timer -= elapsed;
+		c->_pending_idle_deadline -= elapsed;
 
 		Action action = _client_pop_action(c);
 		enum mpd_idle idle = 0;
 
-		// Poll idle
-		if (action.kind == 0 && !SHOULD_FETCH) {
-			if (poll_timer <= 0) {
-				_client_poll_idle(c, &idle);
-				poll_timer = POLL_IDLE_INTERVAL_MS;
-			}
-		} else {
+		bool has_work = action.kind != 0
+			|| SHOULD_FETCH
+			|| c->_queue_resync
+			|| c->_albums_resync
+			|| _client_pending_idle_ready(c)
+			|| _client_has_pending_requests(c, true);
+
+		if (has_work) {
+			// Leave the idle mode to be able to send commands
 			_client_noidle(c, &idle);
+		} else if (readable && c->_polling_idle) {
+			// Server notified about changes
+			if (_client_recv_idle(c, &idle))
+				c->_polling_idle = false;
 		}
 
 		// Eat all remaining actions
-		while (true) {
+		while (action.kind != 0) {
 			_client_handle_action(c, action);
-
 			action = _client_pop_action(c);
-			if (action.kind == 0) break;
 		}
 
 		if (c->_should_close) break;
 
 		_client_fetch_requests(c, &idle);
 
+		idle = _client_coalesce_idle(c, idle);
 		_client_handle_idle(c, idle);
 
 		// Fetch status
@@ -757,11 +1696,24 @@ void _client_loop(Client *c) {
 			_client_push_event(c, (Event){.kind = EVENT_ELAPSED});
 		}
 
-		clock_t end = clock();
-		double time = (double)(end - start) / CLOCKS_PER_SEC * 1000;
-		elapsed = (int)(time + INTERVAL_MS);
+		_client_poll_idle(c);
 
-		SLEEP_MS(INTERVAL_MS);
+		// Sleep until something happens
+		int timeout = -1;
+		if (_client_has_pending_requests(c, false) || c->_queue_resync || c->_albums_resync) {
+			timeout = 0;
+		} else {
+			if (_client_is_playing(c))
+				timeout = MAX(c->_status_fetch_timer, 0);
+
+			int idle_timeout = _client_pending_idle_timeout(c);
+			if (idle_timeout >= 0 && (timeout < 0 || idle_timeout < timeout))
+				timeout = idle_timeout;
+		}
+
+		trace_end(loop_timer);
+
+		readable = _client_wait(c, timeout);
 	}
 
 	_client_free(c);
@@ -773,6 +1725,8 @@ void _client_set_state(Client *c, ClientState state) {
 	WRITE_LOCK(&c->_state_rwlock);
 	c->_state = state;
 	RW_UNLOCK(&c->_state_rwlock);
+
+	_client_wake_ui(c);
 }
 
 ClientState client_get_state(Client *c) {
@@ -785,6 +1739,8 @@ ClientState client_get_state(Client *c) {
 }
 
 void *do_connect(void *client) {
+	trace_set_thread_name("client");
+
 	TraceLog(LOG_INFO, "MPD CLIENT: CONNECTION: Connecting to a MPD server...");
 
 	// TODO: allow users to pass custom host and port via cli args
@@ -810,10 +1766,18 @@ void *do_connect(void *client) {
 	TraceLog(LOG_INFO, "MPD CLIENT: CONNECTION: Successfully connected to a MPD server");
 
 	c->_conn = conn;
+
+	decode_pool_start(
+		&c->_decode_pool,
+		decode_pool_default_threads_count(),
+		_client_decode_artwork,
+		c
+	);
+
 	_client_set_state(c, CLIENT_STATE_READY);
 
 	_client_fetch_status_and_song(c);
-	_client_fetch_queue(c);
+	_client_sync_queue(c);
 	_client_fetch_albums(c);
 
 	_client_loop(c);
@@ -845,7 +1809,10 @@ void client_lock_status_nullable(
 	const struct mpd_song   **cur_song,
 	const struct mpd_status **cur_status
 ) {
+	TraceTimer timer = trace_begin(TRACE_STATUS_LOCK);
 	READ_LOCK(&c->_status_rwlock);
+	trace_end(timer);
+
 	if (cur_song)   *cur_song   = c->_cur_song_nullable;
 	if (cur_status) *cur_status = c->_cur_status_nullable;
 }
@@ -866,3 +1833,21 @@ void album_info_free(AlbumInfo a) {
 	a.artist_nullable = NULL;
 	a.first_song_uri_nullable = NULL;
 }
+
+void event_free(Event event) {
+	switch (event.kind) {
+		case EVENT_QUEUE_CHANGED:
+			_queue_changes_free(&event.data.queue);
+			break;
+		case EVENT_ALBUMS_LIST_CHANGED:
+			for (size_t i = 0; i < event.data.albums.len; i++)
+				album_info_free(event.data.albums.items[i]);
+			free(event.data.albums.items);
+			break;
+		case EVENT_RESPONSE:
+			UnloadImage(event.data.response_artwork.image);
+			break;
+		default:
+			break;
+	}
+}
@@ -21,14 +21,57 @@ void album_info_free(AlbumInfo a);
 #include "./client/action.h"
 #include "./client/event.h"
 
+// Free the data owned by the event
+void event_free(Event event);
+
+#include "./decode_pool.h"
 #include "../thirdparty/uthash.h"
 
-#define STATUS_FETCH_INTERVAL_MS 250
-#define POLL_IDLE_INTERVAL_MS (1000/30)
+// Elapsed time is extrapolated locally (see `client_elapsed_ms()`), status is
+// refetched this often only to correct the drift while playing
+#define STATUS_RESYNC_INTERVAL_MS 10000
 #define READY_ARTWORKS_QUEUE_CAP 8
+// Changes of the subsystems that are expensive to refetch are delayed by
+// this window (can be overriden by `MUPWIT_IDLE_DEBOUNCE_MS` environment
+// variable), so bursts of changes result in a single refetch
+#define IDLE_DEBOUNCE_MS 150
+// Coalesced changes are never delayed more than this many windows, so
+// continuous changes don't postpone the refetch forever
+#define IDLE_DEBOUNCE_MAX_WINDOWS 8
+// Number of first song lookups sent at once when building the albums list
+// Can be overriden by `MUPWIT_ALBUMS_BATCH_SIZE` environment variable, 0
+// makes the client scan all the songs instead (see `ALBUMS_FETCH_PAGE_SIZE`)
+#define ALBUMS_LOOKUP_BATCH_SIZE 128
+// Number of songs received per request when scanning all the songs
+#define ALBUMS_FETCH_PAGE_SIZE 8192
+// Max number of new songs fetched one by one on queue sync, if there are
+// more of them the whole diff is fetched with `plchanges` instead
+#define QUEUE_SYNC_MAX_SONG_QUERIES 1024
 
 extern const char *UNKNOWN;
 
+typedef struct ClientIdleStats {
+	// Number of the coalesced subsystems changes received from the server
+	unsigned received;
+	// Number of refetches that were actually made because of them
+	unsigned fetched;
+} ClientIdleStats;
+
+typedef struct ClientEventStats {
+	// Number of events merged into an already pending event of the same kind
+	unsigned coalesced;
+	// Number of times a producer had to wait for the UI because the events
+	// queue was full
+	unsigned blocked;
+	// Number of events dropped after waiting for `EVENT_PUSH_TIMEOUT_MS`
+	unsigned dropped;
+} ClientEventStats;
+
+typedef struct QueueSongId {
+	unsigned id;
+	UT_hash_handle hh; // to make struct hashable
+} QueueSongId;
+
 // Client connection state
 typedef enum ClientState {
 	CLIENT_STATE_DEAD, // oh no! somebody help him!!
@@ -38,24 +81,61 @@ typedef enum ClientState {
 } ClientState;
 
 struct Client {
-	pthread_mutex_t _actions_mutex;
 	ActionsQueue _actions;
-
-	pthread_mutex_t _events_mutex;
 	EventsQueue _events;
+	// Bit set of the pending events without data, `1 << kind`
+	_Atomic unsigned _pending_signals;
+	// Position in the events ring at which each pending event without data
+	// was raised the last time, so it is popped after the events pushed
+	// before it
+	_Atomic size_t _signal_pos[EVENT_SONG_CHANGED + 1];
+	// See `ClientEventStats`
+	_Atomic unsigned _events_coalesced;
+	_Atomic unsigned _events_blocked;
+	_Atomic unsigned _events_dropped;
+
+	// Pipe used to wake up the client thread when an action is pushed or a
+	// request is made
+	int _wake_fds[2];
+	// Pipe used to wake up the UI thread waiting in `client_wait_events()`
+	// when an event is pushed or the state is changed
+	int _ui_wake_fds[2];
 
 	pthread_mutex_t _reqs_mutex;
 	Request *_reqs;
-	Request *_cur_req;
 	int _last_req_id;
 
+	// Workers decoding downloaded artworks
+	DecodePool _decode_pool;
+
 	bool _polling_idle;
 	int _status_fetch_timer;
-	// Current queue was changed by the user inside MUPWIT
-	// (queue item was reordered, deleted, etc...)
-	bool _queue_changed_inside_mupwit;
 	bool _should_close;
 
+	// Coalesced subsystems changes waiting for the debounce window to end
+	enum mpd_idle _pending_idle;
+	int _idle_debounce_ms;
+	// Time left until the pending changes are handled
+	int _pending_idle_timer;
+	// Time left until the pending changes are handled no matter whether
+	// more changes arrive
+	int _pending_idle_deadline;
+
+	// See `ALBUMS_LOOKUP_BATCH_SIZE`
+	int _albums_batch_size;
+
+	// Queue version (see `mpd_status_get_queue_version()`) the UI is synced with
+	unsigned _queue_version;
+	// Mirror of the UI queue, song ids indexed by position
+	// Used to find out which songs the UI already has
+	struct { DA_FIELDS(unsigned) } _queue_ids;
+	// Set of ids in `_queue_ids`
+	QueueSongId *_queue_ids_set;
+	// Queue changes event was dropped, so the whole queue must be sent again
+	bool _queue_resync;
+	// Albums list event was dropped, so it must be fetched again
+	bool _albums_resync;
+
 	pthread_rwlock_t _status_rwlock;
 	// Currently playing song
 	// Can be `NULL`
@@ -66,9 +146,12 @@ struct Client {
 	// Current playback status
 	// Can be `NULL`
 	struct mpd_status *_cur_status_nullable;
+	// `monotonic_ms()` time at which the current status was received
+	double _cur_status_time_ms;
 
 	pthread_rwlock_t _state_rwlock;
 	ClientState _state;
+	ClientIdleStats _idle_stats;
 	struct mpd_connection *_conn;
 
 	pthread_t _thread;
@@ -84,23 +167,63 @@ bool async_handle_error(struct mpd_async *async, const char *file, int line);
 
 Client client_new(void);
 
+// Must be called only by the UI thread
 void client_push_action(Client *c, Action action);
 void client_push_action_kind(Client *c, ActionKind action);
 
-// Retuns the last occured event
-// Returns zero-initialized `Event` if there is more events
+// Retuns the oldest event
+// Returns zero-initialized `Event` if there is no more events
+// Must be called only by the UI thread
 Event client_pop_event(Client *c);
+// Pop up to `cap` oldest events into `events`
+// Events are popped in the order they were pushed, coalesced events without
+// data take the place of their latest occurrence
+// Returns number of the popped events, 0 if there is no more events
+// Must be called only by the UI thread
+size_t client_pop_events(Client *c, Event *events, size_t cap);
+// Block until an event is pushed, the client state is changed or
+// `timeout_ms` has passed
+// Returns whether the UI was woken up by the client (or a signal)
+// Must be called only by the UI thread
+bool client_wait_events(Client *c, int timeout_ms);
 
 // Make a request.
+// `key` is the artwork identity (see `artwork_key()`) used to look the
+// artwork up in the on-disk cache before asking the server.
+// `size` is the on-screen size of the artwork in pixels, the artwork is
+// decoded to the nearest mip level (see `artwork_size_class()`).
 // Returns id of the request.
 // Returns -1 if something went wrong.
-int client_request(Client *c, const char *song_uri);
+int client_request(
+	Client *c,
+	uint64_t key,
+	int size,
+	const char *song_uri,
+	RequestPriority priority
+);
 // // Get the requested artwork from `client_request()` if any.
 // // Returns whether the response is ready and assigns `image` and `color`.
 // // Assigned `image` and `color` may be zeroed which means that response has
 // // been received but it doesn't contain artwork image.
 // bool client_request_poll_artwork(Client *c, int id, Image *image, Color *color);
 void client_cancel_request(Client *c, int id);
+// Make, cancel and prioritize requests in one go, so the requests are
+// locked only once and the client thread is woken up only once.
+// Ids of the made requests are written into their operations.
+void client_submit_requests(Client *c, RequestOp *ops, size_t len);
+
+// Elapsed time of the currently playing song, extrapolated from the last
+// received status if it is playing, so it is smooth and doesn't need
+// frequent status refetches.
+// Status must be locked with `client_lock_status_nullable()`.
+// Returns 0 if there is no status.
+unsigned client_elapsed_ms(Client *c);
+
+// How many refetches were saved by coalescing subsystems changes
+ClientIdleStats client_get_idle_stats(Client *c);
+// How many events were coalesced, delayed or lost
+// Safe to call from any thread
+ClientEventStats client_get_event_stats(Client *c);
 
 // Connect to a MPD server
 void client_connect(Client *c);
@@ -1,6 +1,7 @@
 #ifndef ACTION_H
 #define ACTION_H
 
+// Must be a power of two
 #define ACTIONS_QUEUE_CAP 16
 
 typedef enum ActionKind {
@@ -34,8 +35,10 @@ typedef struct Action {
 	} data;
 } Action;
 
+// Actions are pushed only by the UI thread and popped only by the client
+// thread
 typedef struct ActionsQueue {
-	RINGBUF_FIELDS(Action, ACTIONS_QUEUE_CAP)
+	SPSC_RING_FIELDS(Action, ACTIONS_QUEUE_CAP)
 } ActionsQueue;
 
 #endif
@@ -1,19 +1,27 @@
 #ifndef EVENT_H
 #define EVENT_H
 
-#define EVENTS_QUEUE_CAP 16
+// Must be a power of two
+#define EVENTS_QUEUE_CAP 64
+// If the events queue is full, producers wait this long for the UI to catch
+// up before dropping the event
+#define EVENT_PUSH_TIMEOUT_MS 1000
 
 typedef enum EventKind {
 	EVENT_NONE = 0,
 
-	// Half of second has passed
+	// Events without data are idempotent, so they never take space in
+	// the events queue and multiple pending events of the same kind are
+	// coalesced into one (see `EVENT_IS_SIGNAL()`)
+
+	// Status was refetched to correct the elapsed time drift
 	EVENT_ELAPSED,
 	// Playback status chagned (pause, resume, seek, etc...)
 	EVENT_STATUS_CHANGED,
 	// Currently playing song was changed
 	EVENT_SONG_CHANGED,
 
-	// Current queue was changed outside MUPWIT (something else made queue to change)
+	// Current queue was changed
 	// Data: `queue`
 	EVENT_QUEUE_CHANGED,
 	// Albums list was changed
@@ -25,10 +33,26 @@ typedef enum EventKind {
 	EVENT_RESPONSE,
 } EventKind;
 
+#define EVENT_IS_SIGNAL(KIND) ((KIND) >= EVENT_ELAPSED && (KIND) <= EVENT_SONG_CHANGED)
+
+// Song that took a new position in the queue
+typedef struct QueueChange {
+	unsigned pos;
+	unsigned id;
+	// Song entity if the song is new to the queue (or it is a full resync),
+	// `NULL` if the song was only moved and the item with the same id must
+	// be reused.
+	// Type is guaranteed to be `MPD_ENTITY_TYPE_SONG`
+	struct mpd_entity *entity_nullable;
+} QueueChange;
+
+// Difference between the previous and the current queue
+// Positions which are not listed in the changes still have the same songs
 typedef struct EventDataQueue {
-	// List MPD queue entities/songs
-	// Entities types are guaranteed to be `MPD_ENTITY_TYPE_SONG`
-	DA_FIELDS(struct mpd_entity*)
+	// Queue length after the changes, songs past it were removed
+	unsigned queue_len;
+	// Changes sorted by position
+	DA_FIELDS(QueueChange)
 } EventDataQueue;
 
 typedef struct EventDataAlbumsList {
@@ -43,14 +67,20 @@ typedef struct Event {
 
 		struct {
 			int id;
+			// See `artwork_key()`
+			uint64_t key;
+			// Mip level of the image, see `artwork_size_class()`
+			int size;
 			Image image;
 			Color color;
 		} response_artwork;
 	} data;
 } Event;
 
+// Events are pushed by the client thread and the decode workers and popped
+// only by the UI thread
 typedef struct EventsQueue {
-	RINGBUF_FIELDS(Event, EVENTS_QUEUE_CAP)
+	MPSC_RING_FIELDS(Event, EVENTS_QUEUE_CAP)
 } EventsQueue;
 
 #endif
@@ -1,16 +1,71 @@
 #ifndef REQUEST_H
 #define REQUEST_H
 
+#include <stdint.h>
 #include <raylib.h>
 
 #include "../../thirdparty/uthash.h"
 
 #define REQUESTS_QUEUE_CAP 32
 
+// Requests with higher priority are fetched and decoded first
+typedef enum RequestPriority {
+	// Artwork that is not visible yet, but probably will be soon
+	REQUEST_PRIORITY_PREFETCH = 0,
+	// Artwork that is visible on the screen
+	REQUEST_PRIORITY_VISIBLE,
+	// Artwork of the currently playing song
+	REQUEST_PRIORITY_URGENT,
+} RequestPriority;
+
+typedef enum RequestState {
+	// Waiting to be looked up in the disk cache or fetched by the client
+	// thread
+	REQUEST_PENDING = 0,
+	// Artwork is being looked up in the disk cache by the decode pool.
+	// Request is freed by the decode worker on a cache hit, otherwise it
+	// is pending again.
+	REQUEST_LOOKUP,
+	// Artwork is being downloaded by the client thread
+	REQUEST_FETCHING,
+	// Artwork was downloaded and is waiting for or being decoded by the
+	// decode pool. Request is freed by the decode worker.
+	REQUEST_DECODING,
+} RequestState;
+
+typedef enum RequestOpKind {
+	REQUEST_OP_MAKE,
+	REQUEST_OP_CANCEL,
+	// Change priority of a pending request
+	REQUEST_OP_PRIORITIZE,
+} RequestOpKind;
+
+// Operation on a request, see `client_submit_requests()`
+typedef struct RequestOp {
+	RequestOpKind kind;
+	// Id of the request to cancel or prioritize
+	// Assigned to the id of the made request (-1 if something went wrong)
+	int id;
+	RequestPriority priority;
+
+	// Only used by `REQUEST_OP_MAKE`, see `client_request()`
+	uint64_t key;
+	int size;
+	const char *song_uri;
+} RequestOp;
+
 typedef struct Request {
 	int id;
+	// Artwork identity, see `artwork_key()`
+	uint64_t key;
+	// Artwork mip level to decode to, see `artwork_size_class()`
+	int size;
 	// Owned uri string
 	char *song_uri;
+	RequestPriority priority;
+	RequestState state;
+	// Artwork is not in the disk cache, so it must be downloaded
+	bool cache_missed;
 	bool canceled;
 	UT_hash_handle hh; // to make struct hashable
 } Request;
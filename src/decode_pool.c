@@ -0,0 +1,128 @@
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <string.h>
+
+#include "./decode_pool.h"
+#include "./macros.h"
+#include "./utils.h"
+#include "./trace.h"
+
+int decode_pool_default_threads_count(void) {
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cores <= 0) cores = 1;
+
+	// Leave one core for the UI and client threads
+	int count = env_int("MUPWIT_DECODE_THREADS", (int)cores - 1);
+	return CLAMP(count, 1, DECODE_POOL_MAX_THREADS);
+}
+
+// Take the job with the highest priority out of the queue
+// Jobs with the same priority are taken in FIFO order
+// Mutex must be locked
+static DecodeJob _decode_pool_take(DecodePool *pool) {
+	assert(pool->len > 0);
+
+	size_t best = 0;
+	for (size_t i = 1; i < pool->len; i++) {
+		if (pool->jobs[i].priority > pool->jobs[best].priority)
+			best = i;
+	}
+
+	DecodeJob job = pool->jobs[best];
+	memmove(
+		&pool->jobs[best],
+		&pool->jobs[best + 1],
+		(pool->len - best - 1) * sizeof(pool->jobs[0])
+	);
+	pool->len -= 1;
+	return job;
+}
+
+static void *_decode_pool_worker(void *pool_) {
+	DecodePool *pool = pool_;
+
+	trace_set_thread_name("decode");
+
+	while (true) {
+		LOCK(&pool->mutex);
+		while (pool->len == 0 && !pool->should_stop)
+			assert(pthread_cond_wait(&pool->cond, &pool->mutex) == 0);
+
+		if (pool->should_stop) {
+			UNLOCK(&pool->mutex);
+			break;
+		}
+
+		DecodeJob job = _decode_pool_take(pool);
+		UNLOCK(&pool->mutex);
+
+		pool->run(pool->ctx, job);
+	}
+
+	return NULL;
+}
+
+void decode_pool_start(DecodePool *pool, int threads_count, DecodeJobFunc run, void *ctx) {
+	assert(threads_count > 0 && threads_count <= DECODE_POOL_MAX_THREADS);
+
+	assert(pthread_mutex_init(&pool->mutex, NULL) == 0);
+	assert(pthread_cond_init(&pool->cond, NULL) == 0);
+	pool->len = 0;
+	pool->should_stop = false;
+	pool->run = run;
+	pool->ctx = ctx;
+	pool->threads_count = 0;
+
+	for (int i = 0; i < threads_count; i++) {
+		int res = pthread_create(&pool->threads[i], NULL, _decode_pool_worker, pool);
+		if (res != 0) {
+			TraceLog(LOG_ERROR, "DECODE POOL: Unable to create worker thread: %d", res);
+			break;
+		}
+		pool->threads_count += 1;
+	}
+
+	if (pool->threads_count == 0) abort();
+
+	TraceLog(LOG_INFO, "DECODE POOL: Started %d worker threads", pool->threads_count);
+}
+
+bool decode_pool_is_full(DecodePool *pool) {
+	LOCK(&pool->mutex);
+	bool full = pool->len >= DECODE_POOL_QUEUE_CAP;
+	UNLOCK(&pool->mutex);
+	return full;
+}
+
+bool decode_pool_push(DecodePool *pool, DecodeJob job) {
+	LOCK(&pool->mutex);
+
+	bool pushed = pool->len < DECODE_POOL_QUEUE_CAP && !pool->should_stop;
+	if (pushed) {
+		pool->jobs[pool->len++] = job;
+		assert(pthread_cond_signal(&pool->cond) == 0);
+	}
+
+	UNLOCK(&pool->mutex);
+	return pushed;
+}
+
+void decode_pool_stop(DecodePool *pool) {
+	LOCK(&pool->mutex);
+	pool->should_stop = true;
+	assert(pthread_cond_broadcast(&pool->cond) == 0);
+	UNLOCK(&pool->mutex);
+
+	for (int i = 0; i < pool->threads_count; i++) {
+		int res = pthread_join(pool->threads[i], NULL);
+		if (res != 0)
+			TraceLog(LOG_ERROR, "DECODE POOL: Unable to join worker thread: %d", res);
+	}
+	pool->threads_count = 0;
+
+	// Nobody is going to decode them
+	for (size_t i = 0; i < pool->len; i++)
+		free(pool->jobs[i].buffer);
+	pool->len = 0;
+}
@@ -0,0 +1,72 @@
+#ifndef DECODE_POOL_H
+#define DECODE_POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#define DECODE_POOL_MAX_THREADS 16
+// Max number of downloaded but not yet decoded artworks
+#define DECODE_POOL_QUEUE_CAP 16
+
+// Downloaded artwork waiting to be decoded, or a requested artwork that
+// must be looked up in the disk cache first
+typedef struct DecodeJob {
+	// ID of the request this artwork belongs to
+	int req_id;
+	// See `artwork_key()`
+	uint64_t key;
+	// Mip level to decode to, see `artwork_size_class()`
+	int size;
+	// Jobs with higher priority are decoded first
+	int priority;
+
+	// Extension of the image file (".png", ".jpg", etc...)
+	const char *filetype;
+	// Owned buffer with the encoded image
+	// `NULL` if the artwork is only looked up in the disk cache
+	unsigned char *buffer;
+	int buffer_size;
+} DecodeJob;
+
+// Called on a worker thread for each job
+// Takes the ownership of the job buffer
+typedef void (*DecodeJobFunc)(void *ctx, DecodeJob job);
+
+// Fixed-size pool of threads decoding artworks with a bounded job queue
+typedef struct DecodePool {
+	pthread_mutex_t mutex;
+	// Signaled when a job is pushed or the pool is stopped
+	pthread_cond_t cond;
+
+	DecodeJob jobs[DECODE_POOL_QUEUE_CAP];
+	size_t len;
+	bool should_stop;
+
+	DecodeJobFunc run;
+	void *ctx;
+
+	pthread_t threads[DECODE_POOL_MAX_THREADS];
+	int threads_count;
+} DecodePool;
+
+// Number of threads based on the number of online CPU cores, can be
+// overriden by `MUPWIT_DECODE_THREADS` environment variable
+int decode_pool_default_threads_count(void);
+
+// Start `threads_count` workers calling `run` for every pushed job
+// `pool` must not be moved after this call
+void decode_pool_start(DecodePool *pool, int threads_count, DecodeJobFunc run, void *ctx);
+
+// Whether the job queue is full and `decode_pool_push()` will fail
+bool decode_pool_is_full(DecodePool *pool);
+
+// Enqueue a job
+// Returns `false` if the queue is full, the job is not taken in that case
+bool decode_pool_push(DecodePool *pool, DecodeJob job);
+
+// Stop and join all the workers
+// Buffers of the jobs that are still in the queue are freed
+void decode_pool_stop(DecodePool *pool);
+
+#endif
@@ -8,6 +8,9 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
 
 #define DA_INIT_CAP 32
 
@@ -67,41 +70,113 @@
 	(da)->items[(da)->len++] = (item); \
 } while (0)
 
-#define RINGBUF_FIELDS(type, capacity) \
-	size_t head; \
-	size_t tail; \
-	size_t cap; \
+// Lock-free ring buffers
+// Capacity must be a power of two. Head and tail are never wrapped, they are
+// wrapped only when indexing the buffer.
+#define CACHE_LINE_SIZE 64
+
+// Single-producer single-consumer ring buffer
+// Zero-initialized ring is empty and ready to use
+#define SPSC_RING_FIELDS(type, capacity) \
+	/* Written only by the producer */ \
+	_Alignas(CACHE_LINE_SIZE) _Atomic size_t head; \
+	/* Written only by the consumer */ \
+	_Alignas(CACHE_LINE_SIZE) _Atomic size_t tail; \
 	type buffer[capacity];
 
-#define RINGBUF_IS_EMPTY(rb) ((rb)->head == (rb)->tail)
-#define RINGBUF_IS_FULL(rb)  (((rb)->head + 1) % (rb)->cap == (rb)->tail)
-#define RINGBUF_LEN(rb)      ((rb)->head >= (rb)->tail \
-		? (rb)->head - (rb)->tail \
-		: (rb)->cap - ((rb)->tail - (rb)->head))
-
-#define RINGBUF_PUSH(rb, item) do { \
-	assert((rb)->cap > 0); \
-	if (!RINGBUF_IS_FULL((rb))) { \
-		(rb)->buffer[(rb)->head] = (item); \
-		(rb)->head = ((rb)->head + 1) % (rb)->cap; \
+#define SPSC_RING_CAP(rb) (sizeof((rb)->buffer) / sizeof((rb)->buffer[0]))
+
+// Push `item` into the ring, assigns `pushed` to `false` if the ring is full
+// Must be called only by the producer thread
+#define SPSC_RING_PUSH(rb, item, pushed) do { \
+	size_t _head = atomic_load_explicit(&(rb)->head, memory_order_relaxed); \
+	size_t _tail = atomic_load_explicit(&(rb)->tail, memory_order_acquire); \
+	(pushed) = _head - _tail < SPSC_RING_CAP(rb); \
+	if ((pushed)) { \
+		(rb)->buffer[_head & (SPSC_RING_CAP(rb) - 1)] = (item); \
+		atomic_store_explicit(&(rb)->head, _head + 1, memory_order_release); \
 	} \
 } while (0)
 
-#define RINGBUF_POP(rb, item, default) do { \
-	assert((rb)->cap > 0); \
-	if (!RINGBUF_IS_EMPTY((rb))) {\
-		/* Acquire and reset item */ \
-		*(item) = (rb)->buffer[(rb)->tail]; \
-		(rb)->buffer[(rb)->tail] = (default); \
-\
-		(rb)->tail = ((rb)->tail + 1) % (rb)->cap; \
+// Pop item from the ring into `*item`, assigns `popped` to `false` if the
+// ring is empty
+// Must be called only by the consumer thread
+#define SPSC_RING_POP(rb, item, popped) do { \
+	size_t _tail = atomic_load_explicit(&(rb)->tail, memory_order_relaxed); \
+	size_t _head = atomic_load_explicit(&(rb)->head, memory_order_acquire); \
+	(popped) = _head != _tail; \
+	if ((popped)) { \
+		*(item) = (rb)->buffer[_tail & (SPSC_RING_CAP(rb) - 1)]; \
+		atomic_store_explicit(&(rb)->tail, _tail + 1, memory_order_release); \
+	} \
+} while (0)
+
+// Multi-producer single-consumer ring buffer (Dmitry Vyukov's bounded queue)
+// Every cell has a sequence number telling whether it is free for the
+// producer with the same position or filled for the consumer.
+// Must be initialized with `MPSC_RING_INIT()`
+#define MPSC_RING_FIELDS(type, capacity) \
+	struct { \
+		_Atomic size_t seq; \
+		type data; \
+	} cells[capacity]; \
+	/* Next position to push into, shared by the producers */ \
+	_Alignas(CACHE_LINE_SIZE) _Atomic size_t enqueue_pos; \
+	/* Next position to pop from, owned by the consumer */ \
+	_Alignas(CACHE_LINE_SIZE) size_t dequeue_pos;
+
+#define MPSC_RING_CAP(rb) (sizeof((rb)->cells) / sizeof((rb)->cells[0]))
+
+// Must be called before any other thread uses the ring
+#define MPSC_RING_INIT(rb) do { \
+	for (size_t _i = 0; _i < MPSC_RING_CAP(rb); _i++) \
+		atomic_init(&(rb)->cells[_i].seq, _i); \
+	atomic_init(&(rb)->enqueue_pos, 0); \
+	(rb)->dequeue_pos = 0; \
+} while (0)
+
+// Push `item` into the ring, assigns `pushed` to `false` if the ring is full
+// Can be called by any number of threads
+#define MPSC_RING_PUSH(rb, item, pushed) do { \
+	size_t _pos = atomic_load_explicit(&(rb)->enqueue_pos, memory_order_relaxed); \
+	(pushed) = false; \
+	while (true) { \
+		size_t _idx = _pos & (MPSC_RING_CAP(rb) - 1); \
+		size_t _seq = atomic_load_explicit(&(rb)->cells[_idx].seq, memory_order_acquire); \
+		intptr_t _diff = (intptr_t)_seq - (intptr_t)_pos; \
+		if (_diff == 0) { \
+			/* Cell is free, try to claim it */ \
+			if (atomic_compare_exchange_weak_explicit( \
+				&(rb)->enqueue_pos, &_pos, _pos + 1, \
+				memory_order_relaxed, memory_order_relaxed \
+			)) { \
+				(rb)->cells[_idx].data = (item); \
+				atomic_store_explicit(&(rb)->cells[_idx].seq, _pos + 1, memory_order_release); \
+				(pushed) = true; \
+				break; \
+			} \
+		} else if (_diff < 0) { \
+			/* Cell wasn't popped yet, the ring is full */ \
+			break; \
+		} else { \
+			/* Another producer claimed the cell */ \
+			_pos = atomic_load_explicit(&(rb)->enqueue_pos, memory_order_relaxed); \
+		} \
 	} \
 } while (0)
 
-#define RINGBUF_PEEK(rb, item, default) do { \
-	assert((rb)->cap > 0); \
-	if (!RINGBUF_IS_EMPTY((rb))) {\
-		*(item) = (rb)->buffer[(rb)->tail]; \
+// Pop item from the ring into `*item`, assigns `popped` to `false` if the
+// ring is empty (or the next item is still being written)
+// Must be called only by the consumer thread
+#define MPSC_RING_POP(rb, item, popped) do { \
+	size_t _pos = (rb)->dequeue_pos; \
+	size_t _idx = _pos & (MPSC_RING_CAP(rb) - 1); \
+	size_t _seq = atomic_load_explicit(&(rb)->cells[_idx].seq, memory_order_acquire); \
+	(popped) = _seq == _pos + 1; \
+	if ((popped)) { \
+		*(item) = (rb)->cells[_idx].data; \
+		atomic_store_explicit(&(rb)->cells[_idx].seq, _pos + MPSC_RING_CAP(rb), memory_order_release); \
+		(rb)->dequeue_pos = _pos + 1; \
 	} \
 } while (0)
 
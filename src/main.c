@@ -9,6 +9,8 @@
 #include "./macros.h"
 #include "./theme.h"
 #include "./restore.h"
+#include "./trace.h"
+#include "./utils.h"
 #include "./pages/player_page.h"
 #include "./pages/albums_page.h"
 #include "./pages/queue_page.h"
@@ -19,6 +21,32 @@
 // TODO: add ability to undo actions like queue reordering or song selection
 // TODO: add log file in release file
 
+// While waiting for something to draw, input is polled this often
+#define IDLE_INPUT_POLL_MS 25
+// Draw a frame at least this often even if nothing has changed
+#define IDLE_FRAME_MS 1000
+
+// Block until there is something new to draw: a frame was requested (see
+// `request_frame()`), an input happened or the client has sent an event
+// Returns whether it had to wait
+static bool _wait_for_frame(Client *client) {
+	int delay_ms = take_frame_request();
+	if (delay_ms < 0) delay_ms = IDLE_FRAME_MS;
+
+	bool waited = false;
+	double start = monotonic_ms();
+	while (!input_happened() && !WindowShouldClose()) {
+		int left_ms = delay_ms - (int)(monotonic_ms() - start);
+		if (left_ms <= 0) break;
+
+		waited = true;
+		if (client_wait_events(client, MIN(left_ms, IDLE_INPUT_POLL_MS))) break;
+		PollInputEvents();
+	}
+
+	return waited;
+}
+
 int main() {
 	if (try_restore()) return 0;
 
@@ -26,9 +54,16 @@ int main() {
 	SetTraceLogLevel(LOG_WARNING);
 #endif
 
+	trace_init();
+	trace_set_thread_name("ui");
+
 	InitWindow(THEME_WINDOW_WIDTH, THEME_WINDOW_HEIGHT, "MUPWIT");
 	SetTargetFPS(60);
 
+#ifdef DEBUG
+	draw_stats_enable();
+#endif
+
 	Client client = client_new();
 	client_connect(&client);
 
@@ -44,7 +79,16 @@ int main() {
 	Queue queue_page = queue_page_new();
 	Albums albums_page = albums_page_new();
 
+	// Draw frames only when something changes
+	bool on_demand = env_int("MUPWIT_ALWAYS_REDRAW", 0) == 0;
+
 	while (true) {
+		if (on_demand) {
+			set_frame_resumed(_wait_for_frame(&client));
+		}
+
+		TraceTimer frame_timer = trace_begin(TRACE_FRAME);
+
 		if (should_close()) {
 			client_push_action_kind(&client, ACTION_CLOSE);
 			break;
@@ -72,16 +116,21 @@ int main() {
 			if (is_key_pressed(KEY_SPACE)) {
 				client_push_action_kind(&client, ACTION_TOGGLE);
 			}
+			if (is_key_pressed(KEY_F3)) {
+				trace_dump();
+			}
 
-			Event event = {0};
-			while (true) {
-				event = client_pop_event(&client);
-				if (event.kind == EVENT_NONE) break;
-
-				state_on_event(&state, event);
-				queue_page_on_event(&queue_page, event);
-				albums_page_on_event(&albums_page, event);
-			};
+			TraceTimer drain_timer = trace_begin(TRACE_EVENT_DRAIN);
+			Event events[EVENTS_QUEUE_CAP];
+			size_t events_len;
+			while ((events_len = client_pop_events(&client, events, EVENTS_QUEUE_CAP)) > 0) {
+				for (size_t i = 0; i < events_len; i++) {
+					state_on_event(&state, events[i]);
+					queue_page_on_event(&queue_page, events[i], ctx);
+					albums_page_on_event(&albums_page, events[i], ctx);
+				}
+			}
+			trace_end(drain_timer);
 
 			state_update(&state, &client);
 		}
@@ -104,24 +153,55 @@ int main() {
 				// TODO: show proper message
 				DrawText("error", 0, 0, 30, BLACK);
 				break;
-			case CLIENT_STATE_READY:
+			case CLIENT_STATE_READY: {
+				TraceTimer timer = trace_begin(TRACE_DRAW_ALBUMS);
 				albums_page_draw(&albums_page, ctx);
+				trace_end(timer);
+
+				timer = trace_begin(TRACE_DRAW_PLAYER);
 				player_page_draw(ctx);
+				trace_end(timer);
 
+				timer = trace_begin(TRACE_DRAW_QUEUE);
 				queue_page_draw(&queue_page, ctx);
+				trace_end(timer);
 
+				timer = trace_begin(TRACE_DRAW_CURRENTLY_PLAYING);
 				currently_playing_draw(ctx);
+				trace_end(timer);
 				break;
+			}
 		}
 
 #ifdef DEBUG
+		// Show draw calls of the frame, the debug stuff itself is not counted
+		DrawStats draw_stats = draw_stats_end_frame();
+		char *draw_stats_str = get_temp_buf();
+		snprintf(
+			draw_stats_str,
+			256,
+			"%d draw calls, %d flushes",
+			draw_stats.draw_calls,
+			draw_stats.flushes
+		);
+		int draw_stats_width = MeasureText(draw_stats_str, 10);
+		DrawText(draw_stats_str, GetScreenWidth() - draw_stats_width - 4, 4, 10, RED);
+
+		// Moves only when a frame is drawn anyway, so it shows when frames are
+		// drawn without keeping the on-demand drawing from idling
 		double time = GetTime() * 10;
 		DrawRectangle(cos(time) * 20 + 20, sin(time) * 20 + 20, 20, 20, ColorAlpha(RED, 0.5));
 #endif
 
 		SetMouseCursor(state.cursor);
 
+		TraceTimer end_timer = trace_begin(TRACE_END_DRAWING);
 		EndDrawing();
+		trace_end(end_timer);
+
+		texture_cache_end_frame(&state.artworks);
+
+		trace_end(frame_timer);
 	}
 
 	CloseWindow();
@@ -136,6 +216,9 @@ int main() {
 	// Wait untill the connection is closed
 	client_wait_for_thread(&client);
 
+	trace_dump();
+	trace_write();
+
 	TraceLog(LOG_INFO, "MUPWIT: Bye");
 
 	return 0;
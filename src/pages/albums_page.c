@@ -1,10 +1,13 @@
 #define _XOPEN_SOURCE 500
 
+#include <stdlib.h>
+#include <math.h>
 #include <string.h>
 
 #include "./albums_page.h"
 #include "../theme.h"
 #include "../macros.h"
+#include "../artwork_cache.h"
 #include "../ui/draw.h"
 #include "../ui/currently_playing.h"
 
@@ -13,6 +16,17 @@
 #define PADDING 8
 #define GAP 8
 
+// Rows around the visible ones whose artworks are prefetched
+#define PREFETCH_ROWS 2
+// Rows that will be scrolled through in this many frames at the current
+// speed are prefetched too
+#define PREFETCH_LOOKAHEAD_FRAMES 20
+// Max number of rows whose artworks may be requested at once
+#define MAX_WINDOW_ROWS 32
+// Prerendered cards are a bit larger than their content, because the artwork
+// border sticks out of it
+#define CARD_CACHE_MARGIN 4
+
 Albums albums_page_new(void) {
 	return (Albums){
 		.items = NULL,
@@ -20,103 +34,197 @@ Albums albums_page_new(void) {
 		.cap = 0,
 
 		.scrollable = scrollable_new(),
+
+		.window_start = 0,
+		.window_end = 0,
+		.prev_scroll = 0,
+
+		.card_cache = render_cache_new(),
+
+		.request_ops = {0},
+		.request_op_items = {0},
 	};
 }
 
 static float item_width = 0;
 static float item_height = 0;
 
-static AlbumItem _album_item_new(AlbumInfo info) {
+static AlbumItem _album_item_new(AlbumInfo info, Context ctx) {
+	const char *artist = info.artist_nullable ? info.artist_nullable : UNKNOWN;
+
 	return (AlbumItem){
 		.info = info,
+		.title = text_layout_new(&ctx.assets->normal_font, THEME_NORMAL_TEXT_SIZE, info.title),
+		.artist = text_layout_new(&ctx.assets->title_font, THEME_TITLE_FONT_SIZE, artist),
 
+		.artwork_key = artwork_key(info.title, info.artist_nullable, info.first_song_uri_nullable),
 		.artwork = artwork_image_new(),
+		.artwork_priority = REQUEST_PRIORITY_PREFETCH,
 		.artwork_tween = timer_new(300, false),
 	};
 }
 
 static void _album_item_free(AlbumItem *item) {
 	album_info_free(item->info);
+	text_layout_free(&item->title);
+	text_layout_free(&item->artist);
 }
 
-static void _album_item_update_artwork(AlbumItem *item, Client *client, bool in_view) {
-	if (item->artwork.received) return;
+// Range of the rows visible at the scroll offset
+static void _rows_visible_at(int scroll, Rect container, int *first, int *last) {
+	*first = floorf((scroll - container.y) / item_height);
+	*last = floorf((scroll - container.y + GetScreenHeight()) / item_height) + 1;
+}
 
-	// FIXME!!!!: artwork loading is annoyingly laggy! Needs to be fixed ASAP!
+static void _albums_push_request_op(Albums *a, size_t idx, RequestOp op) {
+	DA_PUSH(&a->request_ops, op);
+	DA_PUSH(&a->request_op_items, idx);
+}
+
+// Make sure the artwork of the item is requested with the priority
+static void _album_item_want_artwork(Albums *a, size_t idx, RequestPriority priority, Context ctx) {
+	AlbumItem *item = &a->items[idx];
+	if (item->artwork.received) return;
+	// Nothing to fetch the artwork from
+	if (!item->info.first_song_uri_nullable) return;
 
 	if (artwork_image_is_fetching(&item->artwork)) {
-		if (!in_view) {
-			artwork_image_cancel(&item->artwork, client);
+		if (item->artwork_priority != priority) {
+			item->artwork_priority = priority;
+			_albums_push_request_op(a, idx, (RequestOp){
+				.kind = REQUEST_OP_PRIORITIZE,
+				.id = item->artwork.req_id_nullable,
+				.priority = priority,
+			});
 		}
-	} else if (in_view) {
-		artwork_image_fetch(&item->artwork, client, item->info.first_song_uri_nullable);
+		return;
 	}
+
+	int size = (int)item_width;
+	if (artwork_image_lookup(&item->artwork, &ctx.state->artworks, item->artwork_key, size))
+		return;
+
+	item->artwork_priority = priority;
+	_albums_push_request_op(a, idx, (RequestOp){
+		.kind = REQUEST_OP_MAKE,
+		.priority = priority,
+		.key = item->artwork_key,
+		.size = size,
+		.song_uri = item->info.first_song_uri_nullable,
+	});
 }
 
-static void _album_item_draw(size_t idx, AlbumItem *item, Context ctx) {
-	Rect rect = {
-		ctx.state->container.x + (idx % ROW_COUNT) * item_width,
-		ctx.state->container.y - ctx.state->scroll + (idx / ROW_COUNT) * item_height,
-		item_width,
-		item_height
-	};
+static void _album_item_cancel_artwork(Albums *a, size_t idx) {
+	AlbumItem *item = &a->items[idx];
+	if (!artwork_image_is_fetching(&item->artwork)) return;
 
-	bool in_view = CheckCollisionRecs(rect, screen_rect());
-	_album_item_update_artwork(item, ctx.client, in_view);
+	_albums_push_request_op(a, idx, (RequestOp){
+		.kind = REQUEST_OP_CANCEL,
+		.id = item->artwork.req_id_nullable,
+	});
+	item->artwork.req_id_nullable = -1;
+}
 
-	if (!in_view) return;
+// Request artworks of the visible items and prefetch the ones around them,
+// cancel requests of the items that left the window.
+// Rows the list is scrolling to are treated as visible, so their artworks
+// are fetched before the scrolling stops.
+static void _albums_update_requests(Albums *a, Rect container, Context ctx) {
+	int rows = (a->len + ROW_COUNT - 1) / ROW_COUNT;
+
+	int first, last;
+	int target_first, target_last;
+	_rows_visible_at(a->scrollable.scroll, container, &first, &last);
+	_rows_visible_at(a->scrollable.target_scroll, container, &target_first, &target_last);
+
+	// Items that are visible right now will scroll out of view before their
+	// artworks arrive if the list is heading more than a screen away
+	bool passing = abs(a->scrollable.target_scroll - a->scrollable.scroll) > container.height;
+	if (passing) {
+		first = target_first;
+		last = target_last;
+	}
 
-	timer_update(&item->artwork_tween);
+	// The faster the list scrolls, the further ahead artworks are prefetched
+	int velocity = a->scrollable.scroll - a->prev_scroll;
+	a->prev_scroll = a->scrollable.scroll;
+	int lookahead = ceilf(abs(velocity) * PREFETCH_LOOKAHEAD_FRAMES / item_height);
+	lookahead = MIN(lookahead, MAX_WINDOW_ROWS / 2);
 
-	// ==============================
-	// Draw item
-	// ==============================
+	int window_first = MIN(first, target_first) - PREFETCH_ROWS;
+	int window_last = MAX(last, target_last) + PREFETCH_ROWS;
+	if (velocity < 0) window_first -= lookahead;
+	if (velocity > 0) window_last += lookahead;
+	window_first = CLAMP(window_first, 0, rows);
+	window_last = CLAMP(window_last, window_first, MIN(rows, window_first + MAX_WINDOW_ROWS));
 
-	Rect inner = rect_shrink(rect, PADDING, PADDING);
-	Vec offset = {inner.x, inner.y};
+	size_t start = (size_t)window_first * ROW_COUNT;
+	size_t end = MIN((size_t)window_last * ROW_COUNT, a->len);
 
-	Color background = ctx.state->background;
+	a->request_ops.len = 0;
+	a->request_op_items.len = 0;
 
-	Vec mouse_pos = get_mouse_pos();
-	bool is_hovering = CheckCollisionPointRec(mouse_pos, rect);
-	is_hovering = is_hovering && CheckCollisionPointRec(mouse_pos, ctx.state->container);
+	for (size_t i = a->window_start; i < a->window_end; i++) {
+		if (i < start || i >= end) _album_item_cancel_artwork(a, i);
+	}
+	a->window_start = start;
+	a->window_end = end;
+
+	// Requests of the same priority are fetched in FIFO order, so the rows
+	// closest to the ones the list is heading to are requested first
+	int center = (target_first + target_last) / 2;
+	for (int d = 0; center + d < window_last || center - d > window_first; d++) {
+		int row_ids[2] = {center + d, center - d - 1};
+		for (int r = 0; r < 2; r++) {
+			int row = row_ids[r];
+			if (row < window_first || row >= window_last) continue;
+
+			bool visible = (row >= first && row < last) || (row >= target_first && row < target_last);
+			RequestPriority priority = visible ? REQUEST_PRIORITY_VISIBLE : REQUEST_PRIORITY_PREFETCH;
+
+			for (size_t i = (size_t)row * ROW_COUNT; i < (size_t)(row + 1) * ROW_COUNT && i < a->len; i++)
+				_album_item_want_artwork(a, i, priority, ctx);
+		}
+	}
 
-	if (is_hovering) {
-		// Draw background
-		background = ctx.state->foreground;
-		draw_box(ctx.assets, BOX_FILLED_ROUNDED, rect, background);
+	client_submit_requests(ctx.client, a->request_ops.items, a->request_ops.len);
 
-		ctx.state->cursor = MOUSE_CURSOR_POINTING_HAND;
+	for (size_t i = 0; i < a->request_ops.len; i++) {
+		RequestOp op = a->request_ops.items[i];
+		if (op.kind == REQUEST_OP_MAKE)
+			a->items[a->request_op_items.items[i]].artwork.req_id_nullable = op.id;
 	}
+}
 
+// Draw everything inside of the item padding, it only depends on the
+// arguments, so it can be prerendered (see `Albums.card_cache`)
+static void _album_item_draw_content(
+	AlbumItem *item,
+	Rect inner,
+	Color background,
+	const TextureCacheEntry *artwork_texture,
+	Context ctx
+) {
 	// Draw artwork
+	Vec offset = {inner.x, inner.y};
 	Rect artwork_rect = {offset.x, offset.y, inner.width, inner.width};
-	if (item->artwork.exists) {
+	if (artwork_texture) {
 		float alpha = timer_progress(&item->artwork_tween);
-		draw_texture_quad(item->artwork.texture, artwork_rect, ColorAlpha(WHITE, alpha));
+		texture_cache_draw(artwork_texture, artwork_rect, ColorAlpha(WHITE, alpha));
 	}
 	draw_box(ctx.assets, BOX_3D, rect_shrink(artwork_rect, -1, -1), THEME_BLACK);
 	offset.y += artwork_rect.height + GAP;
 
-	// Draw title and artist
-	Text text = {
-		.text = item->info.artist_nullable ? item->info.artist_nullable : UNKNOWN,
-		.font = ctx.assets->title_font,
-		.size = THEME_TITLE_FONT_SIZE,
-		.pos = {0},
-		.color = THEME_BLACK,
-	};
-
-	// Artist badge
-	text.pos = vec(
+	// Draw artist badge
+	Vec pos = vec(
 		artwork_rect.x + PADDING*1.5,
 		artwork_rect.y + artwork_rect.height - THEME_TITLE_FONT_SIZE - PADDING
 	);
 
-	Vec artist_text_size = measure_text(&text);
+	Vec artist_text_size = item->artist.bounds;
 	Rect badge_rect = {
-		text.pos.x,
-		text.pos.y,
+		pos.x,
+		pos.y,
 		MIN(artist_text_size.x, artwork_rect.width - PADDING*3),
 		artist_text_size.y
 	};
@@ -129,36 +237,117 @@ static void _album_item_draw(size_t idx, AlbumItem *item, Context ctx) {
 	);
 
 	// Artist badge text
-	BeginScissorMode(
-		badge_rect.x,
-		badge_rect.y,
-		badge_rect.width,
-		badge_rect.height
-	);
-	draw_cropped_text(
-		text,
+	// NOTE: texts are clipped by `draw_text_layout_cropped()` itself, so cards
+	// don't need scissors that would flush the render batch
+	draw_text_layout_cropped(
+		&item->artist,
+		pos,
 		badge_rect.width + 1,
+		THEME_BLACK,
 		item->artwork.color
 	);
-	EndScissorMode();
 
 	// Title
-	BeginScissorMode(inner.x, inner.y, inner.width, inner.height);
-	text.text = item->info.title;
-	text.font = ctx.assets->normal_font,
-	text.size = THEME_NORMAL_TEXT_SIZE;
-	text.pos = offset;
-	draw_cropped_text(text, inner.width, background);
-	EndScissorMode();
+	draw_text_layout_cropped(&item->title, offset, inner.width, THEME_BLACK, background);
+}
+
+static void _album_item_draw(Albums *a, size_t idx, AlbumItem *item, Context ctx) {
+	Rect rect = {
+		ctx.state->container.x + (idx % ROW_COUNT) * item_width,
+		ctx.state->container.y - ctx.state->scroll + (idx / ROW_COUNT) * item_height,
+		item_width,
+		item_height
+	};
+
+	if (!CheckCollisionRecs(rect, screen_rect())) return;
+
+	timer_update(&item->artwork_tween);
+
+	// ==============================
+	// Draw item
+	// ==============================
+
+	Rect inner = rect_shrink(rect, PADDING, PADDING);
+
+	Color background = ctx.state->background;
+
+	Vec mouse_pos = get_mouse_pos();
+	bool is_hovering = CheckCollisionPointRec(mouse_pos, rect);
+	is_hovering = is_hovering && CheckCollisionPointRec(mouse_pos, ctx.state->container);
+
+	if (is_hovering) {
+		// Draw background
+		background = ctx.state->foreground;
+		draw_box(ctx.assets, BOX_FILLED_ROUNDED, rect, background);
+
+		ctx.state->cursor = MOUSE_CURSOR_POINTING_HAND;
+	}
+
+	const TextureCacheEntry *artwork_texture = artwork_image_texture(&item->artwork, &ctx.state->artworks);
+
+	// Don't prerender the card while the artwork or the background is fading
+	const RenderCacheSlot *slot = NULL;
+	bool rendered = false;
+	if (!timer_playing(&item->artwork_tween) && !timer_playing(&ctx.state->background_tween)) {
+		uint64_t key = render_cache_key(0, item->artwork_key);
+		key = render_cache_key(key, (uintptr_t)item->info.title);
+		key = render_cache_key(key, artwork_texture ? artwork_texture->key : 0);
+		key = render_cache_key(key, (uint32_t)ColorToInt(item->artwork.color));
+		key = render_cache_key(key, (uint32_t)ColorToInt(background));
+
+		slot = render_cache_get(
+			&a->card_cache,
+			key,
+			ceilf(inner.width) + CARD_CACHE_MARGIN*2,
+			ceilf(inner.height) + CARD_CACHE_MARGIN*2,
+			ctx.state->artworks.frame,
+			&rendered
+		);
+	}
+
+	if (!slot) {
+		_album_item_draw_content(item, inner, background, artwork_texture, ctx);
+		return;
+	}
+
+	if (!rendered) {
+		render_cache_begin(&a->card_cache, slot, background);
+		Rect slot_inner = {
+			slot->rect.x + CARD_CACHE_MARGIN,
+			slot->rect.y + CARD_CACHE_MARGIN,
+			inner.width,
+			inner.height
+		};
+		_album_item_draw_content(item, slot_inner, background, artwork_texture, ctx);
+		render_cache_end();
+	}
+	render_cache_draw(
+		&a->card_cache,
+		slot,
+		vec(inner.x - CARD_CACHE_MARGIN, inner.y - CARD_CACHE_MARGIN)
+	);
+}
+
+static void _albums_free_items(Albums *a) {
+	for (size_t i = 0; i < a->len; i++) {
+		_album_item_free(&a->items[i]);
+	}
+	free(a->items);
+	a->len = 0;
+	a->cap = 0;
+	a->items = NULL;
+
+	a->window_start = 0;
+	a->window_end = 0;
 }
 
-static void _albums_update(Albums *a, EventDataAlbumsList data) {
+static void _albums_update(Albums *a, EventDataAlbumsList data, Context ctx) {
 	// Free previous items
-	albums_page_free(a);
+	_albums_free_items(a);
 
 	for (size_t i = 0; i < data.len; i ++) {
 		AlbumInfo info = data.items[i];
-		DA_PUSH(a, _album_item_new(info));
+		DA_PUSH(a, _album_item_new(info, ctx));
 	}
 
 	// Free the array, but not its items, they are owned by `AlbumItem`s
@@ -166,9 +355,10 @@ static void _albums_update(Albums *a, EventDataAlbumsList data) {
 	data.items = NULL;
 }
 
-void albums_page_on_event(Albums *a, Event event) {
+void albums_page_on_event(Albums *a, Event event, Context ctx) {
 	if (event.kind == EVENT_RESPONSE) {
-		for (size_t i = 0; i < a->len; i++) {
+		// Only the items inside of the window have artwork requests
+		for (size_t i = a->window_start; i < a->window_end; i++) {
 			AlbumItem *item = &a->items[i];
 			artwork_image_on_response_event(&item->artwork, event);
 		}
@@ -176,7 +366,7 @@ void albums_page_on_event(Albums *a, Event event) {
 
 	else if (event.kind == EVENT_ALBUMS_LIST_CHANGED) {
 		assert(event.data.albums.items != NULL);
-		_albums_update(a, event.data.albums);
+		_albums_update(a, event.data.albums, ctx);
 	}
 }
 
@@ -218,6 +408,8 @@ void albums_page_draw(Albums *a, Context ctx) {
 	ctx.state->scroll = a->scrollable.scroll;
 	ctx.state->container = container;
 
+	_albums_update_requests(a, container, ctx);
+
 	// Draw scroll thumb
 	scrollable_draw_thumb(&a->scrollable, ctx.state, ctx.state->foreground);
 
@@ -225,18 +417,28 @@ void albums_page_draw(Albums *a, Context ctx) {
 	// Draw items
 	// ==============================
 
-	for (size_t i = 0; i < a->len; i++) {
+	int first_row, last_row;
+	_rows_visible_at(a->scrollable.scroll, container, &first_row, &last_row);
+
+	size_t start = (size_t)MAX(first_row, 0) * ROW_COUNT;
+	size_t end = MIN((size_t)MAX(last_row, 0) * ROW_COUNT, a->len);
+	for (size_t i = start; i < end; i++) {
 		AlbumItem *item = &a->items[i];
-		_album_item_draw(i, item, ctx);
+		_album_item_draw(a, i, item, ctx);
 	}
 }
 
 void albums_page_free(Albums *a) {
-	for (size_t i = 0; i < a->len; i++) {
-		_album_item_free(&a->items[i]);
-	}
-	free(a->items);
-	a->len = 0;
-	a->cap = 0;
-	a->items = NULL;
+	_albums_free_items(a);
+	render_cache_free(&a->card_cache);
+
+	free(a->request_ops.items);
+	a->request_ops.items = NULL;
+	a->request_ops.len = 0;
+	a->request_ops.cap = 0;
+
+	free(a->request_op_items.items);
+	a->request_op_items.items = NULL;
+	a->request_op_items.len = 0;
+	a->request_op_items.cap = 0;
 }
@@ -3,11 +3,20 @@
 
 #include "../context.h"
 #include "../ui/scrollable.h"
+#include "../ui/render_cache.h"
+#include "../ui/text_layout.h"
 
 typedef struct AlbumItem {
 	AlbumInfo info;
+	// Title and artist (or `UNKNOWN`) laid out when the album is received
+	TextLayout title;
+	TextLayout artist;
 
+	// See `artwork_key()`
+	uint64_t artwork_key;
 	ArtworkImage artwork;
+	// Priority of the artwork request if it is being fetched
+	RequestPriority artwork_priority;
 	Timer artwork_tween;
 } AlbumItem;
 
@@ -15,11 +24,26 @@ typedef struct Albums {
 	DA_FIELDS(AlbumItem)
 
 	Scrollable scrollable;
+
+	// Range of the items whose artworks may be requested: the visible items
+	// and the prefetched ones around them. Artworks of the items outside of
+	// it are never being fetched.
+	size_t window_start;
+	size_t window_end;
+	// Scroll offset of the previous frame
+	int prev_scroll;
+
+	// Prerendered cards, see `_album_item_draw_content()`
+	RenderCache card_cache;
+
+	// Request operations of the current frame and indices of their items
+	struct { DA_FIELDS(RequestOp) } request_ops;
+	struct { DA_FIELDS(size_t) } request_op_items;
 } Albums;
 
 Albums albums_page_new(void);
 
-void albums_page_on_event(Albums *a, Event event);
+void albums_page_on_event(Albums *a, Event event, Context ctx);
 
 void albums_page_draw(Albums *a, Context ctx);
 
@@ -6,6 +6,7 @@
 #include "../client.h"
 #include "../theme.h"
 #include "../macros.h"
+#include "../utils.h"
 #include "../ui/draw.h"
 #include "../ui/button.h"
 #include "../ui/progress_bar.h"
@@ -15,22 +16,26 @@
 
 // TODO: draw "no song" when no info about current song is available
 
-static int artwork_frame = 0;
-static int artwork_frame_timer = 0;
-
-static void _draw_artwork(ArtworkImage *artwork, Texture empty_artwork, Rect rect, Color tint) {
+static void _draw_artwork(
+	ArtworkImage *artwork,
+	TextureCache *cache,
+	Texture empty_artwork,
+	Rect rect,
+	Color tint
+) {
 #define FRAME_WIDTH 296
 #define FRAMES_COUNT 4
 #define FRAME_DELAY_MS (1000/2) // 2 fps
 
-	if (artwork->exists)
-		draw_texture_quad(artwork->texture, rect, tint);
+	const TextureCacheEntry *texture = artwork_image_texture(artwork, cache);
+	if (texture)
+		texture_cache_draw(texture, rect, tint);
 	else {
-		artwork_frame_timer -= (int)(GetFrameTime() * 1000);
-		if (artwork_frame_timer <= 0) {
-			artwork_frame = (artwork_frame + 1) % FRAMES_COUNT;
-			artwork_frame_timer = FRAME_DELAY_MS;
-		}
+		// Frame is taken from the clock, not counted with `frame_time()`,
+		// because it doesn't include the time spent waiting for the frame
+		double now = monotonic_ms();
+		int artwork_frame = (int)(now / FRAME_DELAY_MS) % FRAMES_COUNT;
+		request_frame(FRAME_DELAY_MS - (int)fmod(now, FRAME_DELAY_MS));
 
 		Rect src = {artwork_frame * FRAME_WIDTH, 0, FRAME_WIDTH, empty_artwork.height};
 		DrawTexturePro(empty_artwork, src, rect, (Vec){0}, 0, tint);
@@ -62,12 +67,15 @@ void player_page_draw(Context ctx) {
 	const char *album = UNKNOWN;
 	const char *artist = UNKNOWN;
 	enum mpd_state playstate = MPD_STATE_UNKNOWN;
+	unsigned elapsed_ms = 0;
 	unsigned elapsed_sec = 0;
 	unsigned duration_sec = 0;
 
 	if (cur_status_nullable) {
 		playstate = mpd_status_get_state(cur_status_nullable);
-		elapsed_sec = (unsigned)(mpd_status_get_elapsed_ms(cur_status_nullable) / 1000);
+		elapsed_ms = client_elapsed_ms(ctx.client);
+		if (playstate == MPD_STATE_PLAY) request_frame(PLAYBACK_FRAME_MS);
+		elapsed_sec = elapsed_ms / 1000;
 		duration_sec = mpd_status_get_total_time(cur_status_nullable);
 	}
 
@@ -99,6 +107,7 @@ void player_page_draw(Context ctx) {
 	// Previous artwork
 	_draw_artwork(
 		&ctx.state->prev_artwork,
+		&ctx.state->artworks,
 		ctx.assets->empty_artwork,
 		artwork_rect,
 		WHITE
@@ -106,6 +115,7 @@ void player_page_draw(Context ctx) {
 	// Current artwork
 	_draw_artwork(
 		&ctx.state->cur_artwork,
+		&ctx.state->artworks,
 		ctx.assets->empty_artwork,
 		artwork_rect,
 		ColorAlpha(WHITE, state_artwork_alpha(ctx.state))
@@ -116,12 +126,7 @@ void player_page_draw(Context ctx) {
 
 	offset.y += artwork_rect.height + GAP;
 
-	BeginScissorMode(
-		ctx.state->container.x,
-		ctx.state->container.y,
-		ctx.state->container.width,
-		ctx.state->container.height
-	);
+	begin_scissor(ctx.state->container);
 
 	// ==============================
 	// Draw info
@@ -154,7 +159,7 @@ void player_page_draw(Context ctx) {
 	text_bounds = draw_cropped_text(text, ctx.state->container.width, ctx.state->background);
 	offset.y += text_bounds.y;
 
-	EndScissorMode();
+	end_scissor();
 
 	// Draw control buttons
 	offset.y += GAP;
@@ -197,7 +202,7 @@ void player_page_draw(Context ctx) {
 		ctx.state->container.width - ICON_BUTTON_SIZE*3 - GAP,
 		PROGRESS_BAR_HEIGHT
 	);
-	bar.progress = (float)elapsed_sec / (float)duration_sec;
+	bar.progress = (float)elapsed_ms / (float)(duration_sec * 1000);
 	bar.color = THEME_BLACK;
 
 	progress_bar_draw(&bar, ctx);
@@ -5,11 +5,15 @@
 #include "../theme.h"
 #include "../macros.h"
 #include "../utils.h"
+#include "../artwork_cache.h"
 #include "../ui/currently_playing.h"
 
 #include <raymath.h>
 
 #define GRAB_THRESHOLD 8
+// Prerendered rows are a bit wider than their content, because the artwork
+// border sticks out of it
+#define ROW_CACHE_MARGIN 4
 
 // TODO: draw "no songs" when queue is empty
 
@@ -19,6 +23,11 @@ Queue queue_page_new(void) {
 		.len = 0,
 		.cap = 0,
 
+		.animating = {0},
+		.durations = {0},
+		.row_cache = render_cache_new(),
+		.artwork_reqs = NULL,
+
 		.trying_to_grab_idx = -1,
 		.reordering_idx = -1,
 
@@ -26,59 +35,270 @@ Queue queue_page_new(void) {
 	};
 }
 
-static QueueItem _queue_item_new(unsigned number, struct mpd_entity *entity) {
+static void _queue_item_free(QueueItem *i) {
+	if (i->entity) {
+		mpd_entity_free(i->entity);
+		i->entity = NULL;
+	}
+
+	text_layout_free(&i->title);
+	text_layout_free(&i->artist);
+	text_layout_free(&i->duration);
+}
+
+// Replace song of the item, the item takes the ownership of the entity
+static void _queue_item_set_entity(QueueItem *item, struct mpd_entity *entity, Context ctx) {
+	_queue_item_free(item);
+
 	const struct mpd_song *song = mpd_entity_get_song(entity);
-	const char *filename = path_basename(mpd_song_get_uri(song));
+	const char *title = mpd_song_get_tag(song, MPD_TAG_TITLE, 0);
+	const char *artist_nullable = mpd_song_get_tag(song, MPD_TAG_ARTIST, 0);
+
+	item->entity = entity;
+	item->filename = path_basename(mpd_song_get_uri(song));
+	item->artwork_key = artwork_key(
+		mpd_song_get_tag(song, MPD_TAG_ALBUM, 0),
+		artist_nullable,
+		mpd_song_get_uri(song)
+	);
+
+	const Font *font = &ctx.assets->normal_font;
+	item->title = text_layout_new(font, THEME_NORMAL_TEXT_SIZE, title ? title : item->filename);
+	if (artist_nullable)
+		item->artist = text_layout_new(font, THEME_NORMAL_TEXT_SIZE, artist_nullable);
+
+	char duration_str[TIME_BUF_LEN];
+	format_time(duration_str, mpd_song_get_duration(song), false);
+	item->duration = text_layout_new(font, THEME_NORMAL_TEXT_SIZE, duration_str);
+}
 
+static QueueItem _queue_item_new(unsigned number, struct mpd_entity *entity, Context ctx) {
 	QueueItem item = {
 		.number = number,
-		.entity = entity,
-		.filename = filename,
+		.entity = NULL,
 
 		.pos_y = number * QUEUE_ITEM_HEIGHT,
 		.prev_pos_y = number * QUEUE_ITEM_HEIGHT,
 		.pos_tween = timer_new(200, false),
 
-		.duration_str = {0},
+		.title = {0},
+		.artist = {0},
+		.duration = {0},
 	};
 
-	format_time(item.duration_str, mpd_song_get_duration(song), false);
+	_queue_item_set_entity(&item, entity, ctx);
 
 	return item;
 }
 
-static void _queue_item_free(QueueItem *i) {
-	if (i->entity) {
-		mpd_entity_free(i->entity);
-		i->entity = NULL;
+static unsigned _item_song_id(const QueueItem *item) {
+	return mpd_song_get_id(mpd_entity_get_song(item->entity));
+}
+
+static unsigned _item_duration(const QueueItem *item) {
+	return mpd_song_get_duration(mpd_entity_get_song(item->entity));
+}
+
+// Add the item to `Queue.animating` if it isn't there yet
+static void _queue_mark_animating(Queue *q, int idx) {
+	QueueItem *item = &q->items[idx];
+	if (item->animating) return;
+
+	item->animating = true;
+	DA_PUSH(&q->animating, idx);
+}
+
+// Total duration of the items with numbers below `number` in seconds
+static unsigned _queue_duration_before(const Queue *q, int number) {
+	if (number <= 0 || q->durations.len == 0) return 0;
+	return q->durations.items[MIN((size_t)number, q->len)];
+}
+
+// Recompute the durations prefix sums starting from number `from`
+static void _queue_update_durations(Queue *q, size_t from) {
+	DA_RESERVE(&q->durations, q->len + 1);
+	q->durations.len = q->len + 1;
+	q->durations.items[0] = 0;
+
+	// Numbers of the reordered items differ from their indices, so they have
+	// to be looked up
+	int *by_number = NULL;
+	for (size_t i = 0; i <= q->animating.len; i++) {
+		int idx = i < q->animating.len ? q->animating.items[i] : q->reordering_idx;
+		if (idx < 0 || q->items[idx].number == idx) continue;
+		// Stale numbers are put back by `_queue_apply_changes()`, never
+		// write past the table anyway
+		if (q->items[idx].number < 0 || (size_t)q->items[idx].number >= q->len) continue;
+
+		if (!by_number) {
+			by_number = malloc(q->len * sizeof(int));
+			for (size_t n = 0; n < q->len; n++) by_number[n] = n;
+		}
+		by_number[q->items[idx].number] = idx;
+	}
+
+	for (size_t n = from; n < q->len; n++) {
+		const QueueItem *item = &q->items[by_number ? (size_t)by_number[n] : n];
+		q->durations.items[n + 1] = q->durations.items[n] + _item_duration(item);
 	}
+
+	free(by_number);
 }
 
-static void _item_tween_to_rest(QueueItem *e) {
+static void _item_tween_to_rest(Queue *q, int idx) {
+	QueueItem *e = &q->items[idx];
 	e->prev_pos_y = e->pos_y;
 	e->pos_y = e->number * QUEUE_ITEM_HEIGHT;
 	timer_play(&e->pos_tween);
+
+	_queue_mark_animating(q, idx);
 }
 
 static int _item_number_from_pos(QueueItem *e) {
 	return (int)((e->pos_y + QUEUE_ITEM_HEIGHT / 2) / QUEUE_ITEM_HEIGHT);
 }
 
-static void _item_draw(
-	int idx,
+// Get artwork texture of the visible item, requesting it if needed
+// Returns `NULL` if the artwork is not received yet or there is no artwork
+static const TextureCacheEntry *_item_artwork(QueueItem *item, Queue *queue, Context ctx) {
+	uint64_t key = artwork_sized_key(item->artwork_key, QUEUE_ITEM_ARTWORK_SIZE);
+
+	const TextureCacheEntry *entry = texture_cache_get(&ctx.state->artworks, key);
+	if (entry) return entry;
+
+	QueueArtworkRequest *req = NULL;
+	HASH_FIND(hh, queue->artwork_reqs, &key, sizeof(key), req);
+
+	if (!req) {
+		const struct mpd_song *song = mpd_entity_get_song(item->entity);
+
+		req = calloc(1, sizeof(QueueArtworkRequest));
+		req->key = key;
+		req->req_id = client_request(
+			ctx.client,
+			item->artwork_key,
+			QUEUE_ITEM_ARTWORK_SIZE,
+			mpd_song_get_uri(song),
+			REQUEST_PRIORITY_VISIBLE
+		);
+		HASH_ADD(hh, queue->artwork_reqs, key, sizeof(req->key), req);
+	}
+
+	// NOTE: request stays in the table after it was served without an
+	// artwork, so songs without artworks are not requested every frame
+	req->wanted = true;
+	return NULL;
+}
+
+// Cancel requests of the artworks no visible item needs anymore
+static void _queue_page_cancel_unwanted_artworks(Queue *q, Client *client) {
+	QueueArtworkRequest *req, *tmp;
+	HASH_ITER(hh, q->artwork_reqs, req, tmp) {
+		if (req->wanted) {
+			req->wanted = false;
+			continue;
+		}
+
+		if (req->req_id > 0)
+			client_cancel_request(client, req->req_id);
+
+		HASH_DELETE(hh, q->artwork_reqs, req);
+		free(req);
+	}
+}
+
+// Draw everything inside of the item padding, it only depends on the
+// arguments, so it can be prerendered (see `Queue.row_cache`)
+static void _item_draw_content(
 	QueueItem *item,
-	Queue *queue,
+	Rect inner,
+	Color background,
+	const TextureCacheEntry *artwork,
 	Context ctx
 ) {
-#define IS_REORDERING (queue->reordering_idx == idx)
-#define IS_TRYING_TO_GRAB (queue->trying_to_grab_idx == idx)
+	const struct mpd_song *song = mpd_entity_get_song(item->entity);
+
+	// Draw artwork or its placeholder
+	Rect artwork_rect = {
+		inner.x,
+		inner.y + QUEUE_ITEM_HEIGHT/2 - QUEUE_ITEM_ARTWORK_SIZE/2,
+		QUEUE_ITEM_ARTWORK_SIZE,
+		QUEUE_ITEM_ARTWORK_SIZE
+	};
+	if (artwork) {
+		texture_cache_draw(artwork, artwork_rect, WHITE);
+	} else {
+		draw_icon(
+			ctx.assets,
+			ICON_DISK,
+			vec(
+				artwork_rect.x + artwork_rect.width/2 - ICON_SIZE/2,
+				artwork_rect.y + artwork_rect.height/2 - ICON_SIZE/2
+			),
+			THEME_BLACK
+		);
+	}
+	draw_box(ctx.assets, BOX_NORMAL, artwork_rect, THEME_BLACK);
+	inner.x += artwork_rect.width + QUEUE_PAGE_PADDING;
+	inner.width -= artwork_rect.width + QUEUE_PAGE_PADDING;
+
+	// Draw song duration
+	Vec dur_size = item->duration.bounds;
+	draw_text_layout(
+		&item->duration,
+		vec(
+			inner.x + inner.width - dur_size.x,
+			inner.y + QUEUE_ITEM_HEIGHT/2 - dur_size.y/2
+		),
+		THEME_SUBTLE_TEXT
+	);
+	inner.width -= dur_size.x + QUEUE_PAGE_PADDING;
+
+	// NOTE: texts are clipped by `draw_text_layout_cropped()` itself, a scissor
+	// would flush the render batch for every row
+
+	bool has_artist = mpd_song_get_tag(song, MPD_TAG_ARTIST, 0) != NULL;
+
+	// Draw song title
+	Vec pos = vec(
+		inner.x,
+		inner.y + QUEUE_ITEM_HEIGHT/2 - THEME_NORMAL_TEXT_SIZE
+	);
+
+	if (!has_artist) {
+		// Center title if artist is unknown
+		pos.y += THEME_NORMAL_TEXT_SIZE/2;
+	}
+
+	draw_text_layout_cropped(&item->title, pos, inner.width, THEME_TEXT, background);
+	pos.y += THEME_NORMAL_TEXT_SIZE;
+
+	// Draw song artist
+	if (has_artist) {
+		draw_text_layout_cropped(&item->artist, pos, inner.width, THEME_SUBTLE_TEXT, background);
+	}
+}
 
-	Rect rect = {
+// Rectangle of the item at its target position
+static Rect _item_rect(const QueueItem *item, Context ctx) {
+	return (Rect){
 		ctx.state->container.x,
 		ctx.state->container.y - ctx.state->scroll + item->pos_y,
 		ctx.state->container.width,
 		QUEUE_ITEM_HEIGHT
 	};
+}
+
+static void _item_draw(
+	int idx,
+	QueueItem *item,
+	Queue *queue,
+	Context ctx
+) {
+#define IS_REORDERING (queue->reordering_idx == idx)
+#define IS_TRYING_TO_GRAB (queue->trying_to_grab_idx == idx)
+
+	Rect rect = _item_rect(item, ctx);
 
 	// Draw only visible entries
 	if (!CheckCollisionRecs(rect, screen_rect())) return;
@@ -173,78 +393,40 @@ static void _item_draw(
 		);
 	}
 
-	// Draw artwork placeholder
-	// TODO: fetch and show the artwork for each song but first i need to
-	// implement artwork caching
-	Rect artwork_rect = {
-		inner.x,
-		inner.y + QUEUE_ITEM_HEIGHT/2 - QUEUE_ITEM_ARTWORK_SIZE/2,
-		QUEUE_ITEM_ARTWORK_SIZE,
-		QUEUE_ITEM_ARTWORK_SIZE
-	};
-	draw_icon(
-		ctx.assets,
-		ICON_DISK,
-		vec(
-			artwork_rect.x + artwork_rect.width/2 - ICON_SIZE/2,
-			artwork_rect.y + artwork_rect.height/2 - ICON_SIZE/2
-		),
-		THEME_BLACK
-	);
-	draw_box(ctx.assets, BOX_NORMAL, artwork_rect, THEME_BLACK);
-	inner.x += artwork_rect.width + QUEUE_PAGE_PADDING;
-	inner.width -= artwork_rect.width + QUEUE_PAGE_PADDING;
-
-	Text text = {
-		.text = "",
-		.font = ctx.assets->normal_font,
-		.size = THEME_NORMAL_TEXT_SIZE,
-		.pos = {0},
-		.color = THEME_SUBTLE_TEXT,
-	};
-
-	// Draw song duration
-	text.text = item->duration_str;
-	Vec dur_size = measure_text(&text);
-	text.pos = vec(
-		inner.x + inner.width - dur_size.x,
-		inner.y + QUEUE_ITEM_HEIGHT/2 - dur_size.y/2
-	);
-	draw_text(text);
-	inner.width -= dur_size.x + QUEUE_PAGE_PADDING;
-
-	BeginScissorMode(inner.x, inner.y, inner.width, inner.height);
-
-	const char *title = mpd_song_get_tag(song, MPD_TAG_TITLE, 0);
-	const char *artist_nullable = mpd_song_get_tag(song, MPD_TAG_ARTIST, 0);
-	if (!title) {
-		title = item->filename;
+	const TextureCacheEntry *artwork = _item_artwork(item, queue, ctx);
+
+	// Background is tweening after the song change, prerendered rows would
+	// be thrown away on the next frame anyway
+	const RenderCacheSlot *slot = NULL;
+	bool rendered = false;
+	if (!timer_playing(&ctx.state->background_tween)) {
+		uint64_t key = render_cache_key(0, (uintptr_t)item->entity);
+		key = render_cache_key(key, song_id);
+		key = render_cache_key(key, (uint32_t)ColorToInt(background));
+		key = render_cache_key(key, artwork ? artwork->key : 0);
+
+		slot = render_cache_get(
+			&queue->row_cache,
+			key,
+			ceilf(inner.width) + ROW_CACHE_MARGIN*2,
+			QUEUE_ITEM_HEIGHT,
+			ctx.state->artworks.frame,
+			&rendered
+		);
 	}
 
-	// Draw song title
-	text.text = title;
-	text.color = THEME_TEXT;
-	text.pos = vec(
-		inner.x,
-		inner.y + QUEUE_ITEM_HEIGHT/2 - THEME_NORMAL_TEXT_SIZE
-	);
-
-	if (!artist_nullable) {
-		// Center title if artist is unknown
-		text.pos.y += THEME_NORMAL_TEXT_SIZE/2;
+	if (!slot) {
+		_item_draw_content(item, inner, background, artwork, ctx);
+		return;
 	}
 
-	draw_cropped_text(text, inner.width, background);
-	text.pos.y += THEME_NORMAL_TEXT_SIZE;
-
-	// Draw song artist
-	if (artist_nullable) {
-		text.text = artist_nullable;
-		text.color = THEME_SUBTLE_TEXT;
-		draw_cropped_text(text, inner.width, background);
+	if (!rendered) {
+		render_cache_begin(&queue->row_cache, slot, background);
+		Rect slot_inner = {slot->rect.x + ROW_CACHE_MARGIN, slot->rect.y, inner.width, inner.height};
+		_item_draw_content(item, slot_inner, background, artwork, ctx);
+		render_cache_end();
 	}
-
-	EndScissorMode();
+	render_cache_draw(&queue->row_cache, slot, vec(inner.x - ROW_CACHE_MARGIN, inner.y));
 }
 
 // Reorder item UI element, does NOT affect the actual queue.
@@ -270,52 +452,264 @@ static void _queue_page_reorder_entry(Queue *q, QueueItem *item, int to_number)
 
 	if (move_by == 0) return;
 
+#define MOVE(IDX) do { \
+		QueueItem *_another = &q->items[(IDX)]; \
+		if (_another->number >= range_from && _another->number <= range_to) { \
+			int _moved_number = _another->number + move_by; \
+			if (_moved_number >= 0 && _moved_number < (int)q->len) { \
+				_another->number = _moved_number; \
+				_item_tween_to_rest(q, (IDX)); \
+			} \
+		} \
+	} while (0)
+
 	// Reorder all entries inside range `range_from`-`range_to`
+	// Items that are not animating have the same number as their index, so
+	// only the animating ones and the range of indices need to be checked
+	size_t animating_len = q->animating.len;
+	for (size_t i = 0; i < animating_len; i++) {
+		int idx = q->animating.items[i];
+		if (idx == q->reordering_idx) continue;
+		MOVE(idx);
+	}
+	for (int i = MAX(range_from, 0); i <= range_to && i < (int)q->len; i++) {
+		if (i == q->reordering_idx || q->items[i].animating) continue;
+		MOVE(i);
+	}
+
+#undef MOVE
+
+	// Items between the old and the new number were shifted by one
+	unsigned *durations = q->durations.items;
+	unsigned duration = _item_duration(item);
+	if (to_number > item->number) {
+		for (int n = item->number + 1; n <= to_number; n++)
+			durations[n] = durations[n + 1] - duration;
+	} else {
+		for (int n = item->number; n > to_number; n--)
+			durations[n] = durations[n - 1] + duration;
+	}
+
+	item->number = to_number;
+}
+
+static void _queue_page_free_items(Queue *q) {
 	for (size_t i = 0; i < q->len; i++) {
-		if ((int)i == q->reordering_idx) continue;
+		_queue_item_free(&q->items[i]);
+	}
+	free(q->items);
+	q->len = 0;
+	q->cap = 0;
+	q->items = NULL;
+
+	free(q->animating.items);
+	q->animating.items = NULL;
+	q->animating.len = 0;
+	q->animating.cap = 0;
+
+	free(q->durations.items);
+	q->durations.items = NULL;
+	q->durations.len = 0;
+	q->durations.cap = 0;
+}
+
+// Item that left its position, it is either moved or removed
+typedef struct LeftItem {
+	unsigned id;
+	QueueItem item;
+	bool reused;
+	UT_hash_handle hh; // to make struct hashable
+} LeftItem;
+
+// Find the new index of the item with the song `id` that was at `old_idx`
+// Returns -1 if the song was removed
+static int _queue_find_moved(Queue *q, EventDataQueue changes, int old_idx, unsigned id) {
+	if (old_idx < (int)q->len && _item_song_id(&q->items[old_idx]) == id)
+		return old_idx;
+
+	for (size_t i = 0; i < changes.len; i++) {
+		if (changes.items[i].id == id)
+			return changes.items[i].pos;
+	}
+
+	return -1;
+}
+
+// Apply queue changes in place
+// Items that were only moved keep their state and smoothly move to their
+// new positions
+static void _queue_apply_changes(Queue *q, EventDataQueue changes, Context ctx) {
+	// Items array always has the same order as the actual queue, reordering
+	// only changes item numbers until the changes arrive
+	size_t old_len = q->len;
+
+	int reordering_id = -1;
+	int grabbing_id = -1;
+	if (q->reordering_idx >= 0)
+		reordering_id = _item_song_id(&q->items[q->reordering_idx]);
+	if (q->trying_to_grab_idx >= 0)
+		grabbing_id = _item_song_id(&q->items[q->trying_to_grab_idx]);
+
+	// Animating items may change their indices, so the list is rebuilt from
+	// the previously animating indices and the changed positions
+	int *was_animating = q->animating.items;
+	size_t was_animating_len = q->animating.len;
+
+	// Durations after the first changed position have to be recomputed,
+	// as well as after the first reordered item
+	size_t durations_from = MIN(old_len, changes.queue_len);
+	if (changes.len > 0)
+		durations_from = MIN(durations_from, changes.items[0].pos);
+	for (size_t i = 0; i <= was_animating_len; i++) {
+		int idx = i < was_animating_len ? was_animating[i] : q->reordering_idx;
+		if (idx < 0) continue;
+
+		int first = MIN(idx, q->items[idx].number);
+		durations_from = MIN(durations_from, (size_t)first);
+		if (i < was_animating_len) q->items[idx].animating = false;
+	}
+	q->animating.items = NULL;
+	q->animating.len = 0;
+	q->animating.cap = 0;
+
+	// Take out items from the changed and removed positions
+	size_t left_cap = changes.len + (old_len > changes.queue_len ? old_len - changes.queue_len : 0);
+	LeftItem *left = malloc(MAX(left_cap, 1) * sizeof(LeftItem));
+	LeftItem *left_by_id = NULL;
+	size_t left_len = 0;
+
+#define TAKE_OUT(POS) do { \
+		QueueItem *_item = &q->items[(POS)]; \
+		if (_item->entity == NULL) break; \
+		LeftItem *_left = &left[left_len++]; \
+		*_left = (LeftItem){ .id = _item_song_id(_item), .item = *_item, .reused = false }; \
+		HASH_ADD_INT(left_by_id, id, _left); \
+		_item->entity = NULL; \
+	} while (0)
+
+	for (size_t i = 0; i < changes.len; i++) {
+		if (changes.items[i].pos < old_len)
+			TAKE_OUT(changes.items[i].pos);
+	}
+	for (size_t pos = changes.queue_len; pos < old_len; pos++)
+		TAKE_OUT(pos);
+
+#undef TAKE_OUT
+
+	DA_RESERVE(q, changes.queue_len);
+	q->len = changes.queue_len;
+
+	// Put items into their new positions
+	for (size_t i = 0; i < changes.len; i++) {
+		QueueChange change = changes.items[i];
+
+		LeftItem *found = NULL;
+		HASH_FIND_INT(left_by_id, &change.id, found);
+
+		QueueItem *item = &q->items[change.pos];
+		if (found && !found->reused) {
+			found->reused = true;
+			*item = found->item;
 
-		QueueItem *another = &q->items[i];
+			if (change.entity_nullable)
+				_queue_item_set_entity(item, change.entity_nullable, ctx);
 
-		if (another->number >= range_from && another->number <= range_to) {
-			int moved_number = another->number + move_by;
-			if (moved_number >= 0 && moved_number < (int)q->len) {
-				another->number = moved_number;
-				_item_tween_to_rest(another);
+			if (item->number != (int)change.pos) {
+				item->number = change.pos;
+				_item_tween_to_rest(q, change.pos);
 			}
+		} else {
+			assert(change.entity_nullable != NULL);
+			*item = _queue_item_new(change.pos, change.entity_nullable, ctx);
 		}
 	}
 
-	item->number = to_number;
-}
+	// Free removed items
+	for (size_t i = 0; i < left_len; i++) {
+		if (left[i].reused) continue;
 
-static void _queue_update(Queue *q, EventDataQueue data) {
-	q->trying_to_grab_idx = -1;
-	q->reordering_idx = -1;
-	q->reorder_click_offset_y = 0;
+		_queue_item_free(&left[i].item);
+	}
+	HASH_CLEAR(hh, left_by_id);
+	free(left);
+
+#define RECHECK_ANIMATING(IDX) do { \
+		size_t _idx = (IDX); \
+		if (_idx >= q->len) break; \
+		QueueItem *_item = &q->items[_idx]; \
+		if (_item->number != (int)_idx || timer_playing(&_item->pos_tween)) \
+			_queue_mark_animating(q, _idx); \
+	} while (0)
+
+	for (size_t i = 0; i < was_animating_len; i++)
+		RECHECK_ANIMATING(was_animating[i]);
+	for (size_t i = 0; i < changes.len; i++)
+		RECHECK_ANIMATING(changes.items[i].pos);
+	free(was_animating);
+
+#undef RECHECK_ANIMATING
+
+	// Items keep the numbers they were reordered to until the move arrives
+	// from the server, but if the queue length was changed by someone else
+	// in the meantime, those numbers may point past the queue or to
+	// the wrong items, so put them back where they actually are
+	for (size_t i = 0; i < q->animating.len; i++) {
+		int idx = q->animating.items[i];
+		QueueItem *item = &q->items[idx];
+		if (item->number == idx) continue;
+
+		if (changes.queue_len != old_len || (size_t)item->number >= q->len) {
+			item->number = idx;
+			_item_tween_to_rest(q, idx);
+		}
+	}
 
-	// Free previous items
-	queue_page_free(q);
+	// Restore drag state
+	if (reordering_id >= 0) {
+		q->reordering_idx = _queue_find_moved(q, changes, q->reordering_idx, reordering_id);
 
-	for (size_t i = 0; i < data.len; i ++) {
-		struct mpd_entity *entity = data.items[i];
+		// Put all the items back where they actually are, the dragged item
+		// will push them aside again on the next frame
+		for (size_t i = 0; i < q->animating.len; i++) {
+			int idx = q->animating.items[i];
+			if (idx == q->reordering_idx) continue;
 
-		// Count total queue duration
-		const struct mpd_song *song = mpd_entity_get_song(entity);
-		q->total_duration_sec += mpd_song_get_duration(song);
+			if (q->items[idx].number != idx) {
+				q->items[idx].number = idx;
+				_item_tween_to_rest(q, idx);
+			}
+		}
 
-		unsigned number = q->len;
-		DA_PUSH(q, _queue_item_new(number, entity));
+		if (q->reordering_idx >= 0) {
+			q->items[q->reordering_idx].number = q->reordering_idx;
+			q->reordered_from_number = q->reordering_idx;
+		}
 	}
+	if (grabbing_id >= 0)
+		q->trying_to_grab_idx = _queue_find_moved(q, changes, q->trying_to_grab_idx, grabbing_id);
+
+	_queue_update_durations(q, durations_from);
 
-	// Free the array, but not its items, they are owned by `QueueItem`s
-	free(data.items);
-	data.items = NULL;
+	// Free the array, but not its entities, they are owned by `QueueItem`s now
+	free(changes.items);
 }
 
-void queue_page_on_event(Queue *q, Event event) {
+void queue_page_on_event(Queue *q, Event event, Context ctx) {
 	if (event.kind == EVENT_QUEUE_CHANGED) {
-		assert(event.data.queue.items != NULL);
-		_queue_update(q, event.data.queue);
+		_queue_apply_changes(q, event.data.queue, ctx);
+	} else if (event.kind == EVENT_RESPONSE) {
+		// Artwork is in the texture cache now (see `state_on_event()`)
+		uint64_t key = artwork_sized_key(
+			event.data.response_artwork.key,
+			event.data.response_artwork.size
+		);
+
+		QueueArtworkRequest *req = NULL;
+		HASH_FIND(hh, q->artwork_reqs, &key, sizeof(key), req);
+		if (req && req->req_id == event.data.response_artwork.id) {
+			HASH_DELETE(hh, q->artwork_reqs, req);
+			free(req);
+		}
 	}
 }
 
@@ -356,8 +750,8 @@ static void _queue_page_draw_reordering_item(Queue *q, Context ctx) {
 			}
 		);
 
-		_item_tween_to_rest(reordering);
 		q->reordering_idx = -1;
+		_item_tween_to_rest(q, reordering - q->items);
 	}
 }
 
@@ -444,23 +838,42 @@ void queue_page_draw(Queue *q, Context ctx) {
 	// Draw entries
 	// ==============================
 
-	unsigned elapsed_sec = 0;
-	if (cur_status_nullable)
-		elapsed_sec = mpd_status_get_elapsed_ms(cur_status_nullable) / (int)1000;
+	// Range of the indices of visible items at rest
+	int first_visible = floorf((ctx.state->scroll - ctx.state->container.y) / QUEUE_ITEM_HEIGHT);
+	int last_visible = ceilf((ctx.state->scroll - ctx.state->container.y + sh) / QUEUE_ITEM_HEIGHT);
+	first_visible = MAX(first_visible, 0);
+	last_visible = MIN(last_visible, (int)q->len);
 
-	for (size_t i = 0; i < q->len; i++) {
-		QueueItem *item = &q->items[i];
+	for (int i = first_visible; i < last_visible; i++) {
+		if (i == q->reordering_idx) continue;
 
-		// TODO: it would be better to cache the total elapsed time
-		if (cur_status_nullable) {
-			if (item->number < mpd_status_get_song_pos(cur_status_nullable)) {
-				elapsed_sec += mpd_song_get_duration(mpd_entity_get_song(item->entity));
-			}
-		}
+		_item_draw(i, &q->items[i], q, ctx);
+	}
+
+	// Draw animating items that are not in the visible range and forget
+	// the ones that came to rest
+	for (size_t i = q->animating.len; i-- > 0;) {
+		int idx = q->animating.items[i];
+		if (idx == q->reordering_idx) continue;
 
-		if ((int)i == q->reordering_idx) continue;
+		QueueItem *item = &q->items[idx];
+		if (idx < first_visible || idx >= last_visible)
+			_item_draw(idx, item, q, ctx);
 
-		_item_draw((int)i, item, q, ctx);
+		// Nobody will see the tween of an invisible item
+		if (!CheckCollisionRecs(_item_rect(item, ctx), screen_rect()))
+			item->pos_tween.elapsed_ms = item->pos_tween.duration_ms;
+
+		if (item->number == idx && !timer_playing(&item->pos_tween)) {
+			item->animating = false;
+			q->animating.items[i] = q->animating.items[--q->animating.len];
+		}
+	}
+
+	unsigned elapsed_sec = 0;
+	if (cur_status_nullable) {
+		elapsed_sec = client_elapsed_ms(ctx.client) / 1000;
+		elapsed_sec += _queue_duration_before(q, mpd_status_get_song_pos(cur_status_nullable));
 	}
 
 	// Draw item that is currently being reordered
@@ -503,9 +916,10 @@ void queue_page_draw(Queue *q, Context ctx) {
 	draw_text(text);
 
 	// Draw queue elapsed time
+	unsigned total_duration_sec = _queue_duration_before(q, q->len);
 	unsigned time_left = 0;
-	if (elapsed_sec <= q->total_duration_sec)
-		time_left = q->total_duration_sec - elapsed_sec;
+	if (elapsed_sec <= total_duration_sec)
+		time_left = total_duration_sec - elapsed_sec;
 
 	static char time_left_str[TIME_BUF_LEN] = {0};
 	format_time(time_left_str, time_left, true);
@@ -516,15 +930,17 @@ void queue_page_draw(Queue *q, Context ctx) {
 	draw_text(text);
 
 defer:
+	_queue_page_cancel_unwanted_artworks(q, ctx.client);
 	client_unlock_status(ctx.client);
 }
 
 void queue_page_free(Queue *q) {
-	for (size_t i = 0; i < q->len; i++) {
-		_queue_item_free(&q->items[i]);
+	_queue_page_free_items(q);
+	render_cache_free(&q->row_cache);
+
+	QueueArtworkRequest *req, *tmp;
+	HASH_ITER(hh, q->artwork_reqs, req, tmp) {
+		HASH_DELETE(hh, q->artwork_reqs, req);
+		free(req);
 	}
-	free(q->items);
-	q->len = 0;
-	q->cap = 0;
-	q->items = NULL;
 }
@@ -4,6 +4,8 @@
 #include "../context.h"
 #include "../ui/draw.h"
 #include "../ui/scrollable.h"
+#include "../ui/render_cache.h"
+#include "../ui/text_layout.h"
 
 #define QUEUE_PAGE_PADDING 8
 #define QUEUE_ITEM_ARTWORK_SIZE 32
@@ -17,6 +19,8 @@ typedef struct QueueItem {
 	// Type is guaranteed to be `MPD_ENTITY_TYPE_SONG`
 	struct mpd_entity *entity;
 	const char *filename;
+	// See `artwork_key()`
+	uint64_t artwork_key;
 
 	// Position of the entry in the queue (0-based)
 	int number;
@@ -26,15 +30,47 @@ typedef struct QueueItem {
 	// Used to smoothly interpolate between this value and `pos_y`.
 	float prev_pos_y;
 	Timer pos_tween;
-
-	// Prerendered song duration in human-readable format
-	char duration_str[TIME_BUF_LEN];
+	// Whether the item is in `Queue.animating`
+	bool animating;
+
+	// Song title (or file name if it has no title), artist and duration in
+	// human-readable format laid out when the song is received
+	TextLayout title;
+	TextLayout artist;
+	TextLayout duration;
 } QueueItem;
 
+// Artwork requested by the queue items
+// Songs of the same album share the artwork, so artworks are requested
+// per key instead of per item
+typedef struct QueueArtworkRequest {
+	// `artwork_sized_key()` of the requested artwork
+	uint64_t key;
+	int req_id;
+	// Whether any visible item needed this artwork during the current frame
+	bool wanted;
+	UT_hash_handle hh; // to make struct hashable
+} QueueArtworkRequest;
+
 typedef struct Queue {
 	DA_FIELDS(QueueItem)
 
-	unsigned total_duration_sec;
+	// Indices of the items that may be drawn away from their index in
+	// the array: their `number` differs from the index or their position is
+	// tweening. All the other items are at rest, so only the items with
+	// visible indices are drawn.
+	struct { DA_FIELDS(int) } animating;
+
+	// Prerendered rows, see `_item_draw_content()`
+	RenderCache row_cache;
+
+	// Artworks that are being requested
+	QueueArtworkRequest *artwork_reqs;
+
+	// Prefix sums of the song durations in seconds by item numbers,
+	// `durations.items[n]` is the total duration of the items with numbers
+	// below `n` (`len + 1` elements)
+	struct { DA_FIELDS(unsigned) } durations;
 
 	int trying_to_grab_idx;
 	// Currently reordering entry index
@@ -51,7 +87,7 @@ typedef struct Queue {
 
 Queue queue_page_new(void);
 
-void queue_page_on_event(Queue *q, Event event);
+void queue_page_on_event(Queue *q, Event event, Context ctx);
 
 void queue_page_draw(Queue *q, Context ctx);
 
@@ -4,6 +4,7 @@
 #include "./theme.h"
 #include "./state.h"
 #include "./macros.h"
+#include "./artwork_cache.h"
 #include "./ui/draw.h"
 
 #include <raymath.h>
@@ -16,9 +17,11 @@ static Color calc_foreground(Color bg) {
 
 State state_new(void) {
 	return (State){
+		.artworks = texture_cache_new(TEXTURE_CACHE_DEFAULT_BUDGET),
+
 		.prev_artwork = artwork_image_new(),
 		.cur_artwork = artwork_image_new(),
-		.cur_artwork_image = (Image){0},
+		.next_artwork = artwork_image_new(),
 		.artwork_fetch_timer = timer_new(ARTWORK_FETCH_DELAY_MS, false),
 
 		.foreground = calc_foreground(THEME_BACKGROUND),
@@ -46,32 +49,10 @@ static void _state_set_page(State *s, Page page) {
 	timer_play(&s->page_tween);
 }
 
-static void _state_set_prev_artwork(State *s) {
-	if (!s->cur_artwork.exists) {
-		if (s->cur_artwork_image.data != NULL) {
-			UnloadImage(s->cur_artwork_image);
-			s->cur_artwork_image = (Image){0};
-		}
-
-		s->prev_artwork.exists = false;
-		return;
-	}
-
-	if (s->cur_artwork_image.data != NULL) {
-		update_texture_from_image(&s->prev_artwork.texture, s->cur_artwork_image);
-		UnloadImage(s->cur_artwork_image);
-		s->cur_artwork_image = (Image){0};
-	}
-
-	s->prev_artwork.color = s->cur_artwork.color;
-	s->prev_artwork.exists = true;
-}
-
-static void _state_update_artworks(State *s, Image image) {
-	_state_set_prev_artwork(s);
+static void _state_set_artwork(State *s, ArtworkImage artwork) {
+	s->prev_artwork = s->cur_artwork;
+	s->cur_artwork = artwork;
 	_state_start_background_tween(s);
-
-	s->cur_artwork_image = image;
 }
 
 static void _state_update_artwork_fetching(State *s, Client *client) {
@@ -79,13 +60,41 @@ static void _state_update_artwork_fetching(State *s, Client *client) {
 		const struct mpd_song *cur_song_nullable;
 		client_lock_status_nullable(client, &cur_song_nullable, NULL);
 
+		artwork_image_cancel(&s->next_artwork, client);
+
 		if (cur_song_nullable) {
 			const char *song_uri = mpd_song_get_uri(cur_song_nullable);
-			artwork_image_fetch(&s->cur_artwork, client, song_uri);
+			uint64_t key = artwork_key(
+				mpd_song_get_tag(cur_song_nullable, MPD_TAG_ALBUM, 0),
+				mpd_song_get_tag(cur_song_nullable, MPD_TAG_ARTIST, 0),
+				song_uri
+			);
+
+			// Songs of the same album share the same artwork, so there is
+			// nothing to do
+			bool same_artwork = s->cur_artwork.exists && s->cur_artwork.key == key;
+
+			// The player artwork spans almost the whole window width
+			int size = ARTWORK_MAX_SIZE;
+
+			if (!same_artwork) {
+				bool cached = artwork_image_fetch(
+					&s->next_artwork,
+					&s->artworks,
+					client,
+					key,
+					size,
+					song_uri,
+					REQUEST_PRIORITY_URGENT
+				);
+
+				if (cached) {
+					_state_set_artwork(s, s->next_artwork);
+					s->next_artwork = artwork_image_new();
+				}
+			}
 		} else {
-			_state_set_prev_artwork(s);
-			s->cur_artwork.exists = false;
-			_state_start_background_tween(s);
+			_state_set_artwork(s, artwork_image_new());
 		}
 
 		client_unlock_status(client);
@@ -104,8 +113,23 @@ void state_on_event(State *s, Event event) {
 	if (event.kind == EVENT_RESPONSE) {
 		assert(event.data.response_artwork.image.data != NULL);
 
-		artwork_image_on_response_event(&s->cur_artwork, event);
-		_state_update_artworks(s, event.data.response_artwork.image);
+		// Every received artwork goes into the shared texture cache, so
+		// pages only need to remember the key
+		texture_cache_put(
+			&s->artworks,
+			artwork_sized_key(
+				event.data.response_artwork.key,
+				event.data.response_artwork.size
+			),
+			event.data.response_artwork.image,
+			event.data.response_artwork.color
+		);
+		UnloadImage(event.data.response_artwork.image);
+
+		if (artwork_image_on_response_event(&s->next_artwork, event)) {
+			_state_set_artwork(s, s->next_artwork);
+			s->next_artwork = artwork_image_new();
+		}
 	}
 
 	if (event.kind == EVENT_SONG_CHANGED) {
@@ -121,6 +145,10 @@ void state_update(State *s, Client *client) {
 
 	_state_update_artwork_fetching(s, client);
 
+	// Keep player artworks in the cache even if the player page is not shown
+	artwork_image_texture(&s->prev_artwork, &s->artworks);
+	artwork_image_texture(&s->cur_artwork, &s->artworks);
+
 	// Update background animation
 	if (!timer_finished(&s->background_tween)) {
 		Color target_color = THEME_BACKGROUND;
@@ -173,6 +201,5 @@ float state_artwork_alpha(State *s) {
 }
 
 void state_free(State *s) {
-	if (s->cur_artwork_image.data)
-		UnloadImage(s->cur_artwork_image);
+	texture_cache_free(&s->artworks);
 }
@@ -14,14 +14,16 @@ typedef enum Page {
 } Page;
 
 typedef struct State {
-	// TODO: cache all the artworks by album name
+	// All the artwork textures keyed by album
+	TextureCache artworks;
 
 	// Previously playing song album artwork
 	ArtworkImage prev_artwork;
 	// Currently playing song album artwork
 	ArtworkImage cur_artwork;
-	// Image data of the current artwork image
-	Image cur_artwork_image;
+	// Requested artwork of the new song
+	// Becomes `cur_artwork` once received
+	ArtworkImage next_artwork;
 	Timer artwork_fetch_timer;
 	bool fetch_artwork_on_timer_finish;
 
@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <stdatomic.h>
+
+#include "./trace.h"
+#include "./utils.h"
+#include "./macros.h"
+
+typedef struct TraceHistogram {
+	_Atomic uint64_t count;
+	_Atomic uint64_t total_us;
+	_Atomic uint64_t max_us;
+	_Atomic uint64_t buckets[TRACE_HISTOGRAM_BUCKETS];
+} TraceHistogram;
+
+static const char *OP_NAMES[TRACE_OPS_COUNT] = {
+	[TRACE_STATUS_FETCH]   = "status fetch",
+	[TRACE_QUEUE_FETCH]    = "queue fetch",
+	[TRACE_ALBUMS_FETCH]   = "albums fetch",
+	[TRACE_READPICTURE]    = "readpicture",
+	[TRACE_DECODE]         = "decode",
+	[TRACE_TEXTURE_UPLOAD] = "texture upload",
+	[TRACE_FRAME]          = "frame",
+
+	[TRACE_CLIENT_LOOP]    = "client loop",
+	[TRACE_HANDLE_ACTION]  = "handle action",
+	[TRACE_STATUS_LOCK]    = "status lock",
+
+	[TRACE_EVENT_DRAIN]            = "event drain",
+	[TRACE_DRAW_ALBUMS]            = "draw albums",
+	[TRACE_DRAW_PLAYER]            = "draw player",
+	[TRACE_DRAW_QUEUE]             = "draw queue",
+	[TRACE_DRAW_CURRENTLY_PLAYING] = "draw currently playing",
+	[TRACE_END_DRAWING]            = "EndDrawing",
+};
+
+// Complete event ("ph": "X") of the Chrome trace format
+typedef struct TraceSpan {
+	TraceOp op;
+	int tid;
+	double start_ms;
+	double duration_ms;
+} TraceSpan;
+
+static TraceHistogram histograms[TRACE_OPS_COUNT] = {0};
+
+// Path of the trace file, `NULL` if recording is disabled
+static const char *trace_path = NULL;
+static TraceSpan *spans = NULL;
+// Number of spans ever recorded, only the last `TRACE_EVENTS_CAP` are kept
+static _Atomic uint64_t spans_count = 0;
+
+static _Atomic int threads_count = 0;
+static const char *thread_names[TRACE_MAX_THREADS] = {0};
+// Index of the calling thread, 0 if it wasn't assigned yet
+static _Thread_local int thread_id = 0;
+
+static int _thread_id(void) {
+	if (thread_id == 0)
+		thread_id = atomic_fetch_add(&threads_count, 1) + 1;
+	return thread_id;
+}
+
+void trace_init(void) {
+	const char *path = getenv("MUPWIT_TRACE_FILE");
+	if (!path || path[0] == '\0') return;
+
+	spans = malloc(sizeof(TraceSpan) * TRACE_EVENTS_CAP);
+	if (!spans) {
+		TraceLog(LOG_WARNING, "TRACE: Unable to allocate spans buffer, trace won't be recorded");
+		return;
+	}
+
+	trace_path = path;
+	TraceLog(LOG_INFO, "TRACE: Recording trace into %s", trace_path);
+}
+
+void trace_set_thread_name(const char *name) {
+	int tid = _thread_id();
+	if (tid < TRACE_MAX_THREADS)
+		thread_names[tid] = name;
+}
+
+static int _bucket(uint64_t us) {
+	int bucket = 0;
+	while (us > 0 && bucket < TRACE_HISTOGRAM_BUCKETS - 1) {
+		us >>= 1;
+		bucket += 1;
+	}
+	return bucket;
+}
+
+// Upper bound of the duration below which `percent` of the records are
+// Returns milliseconds
+static double _percentile(const TraceHistogram *h, uint64_t count, int percent) {
+	uint64_t max = atomic_load_explicit(&h->max_us, memory_order_relaxed);
+	uint64_t target = (count * percent + 99) / 100;
+	uint64_t seen = 0;
+	for (int i = 0; i < TRACE_HISTOGRAM_BUCKETS - 1; i++) {
+		seen += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+		if (seen >= target) {
+			uint64_t bound = (uint64_t)1 << i;
+			return (double)MIN(bound, max) / 1000.0;
+		}
+	}
+	return (double)max / 1000.0;
+}
+
+TraceTimer trace_begin(TraceOp op) {
+	return (TraceTimer){
+		.op = op,
+		.start_ms = monotonic_ms(),
+	};
+}
+
+double trace_end(TraceTimer timer) {
+	double duration = monotonic_ms() - timer.start_ms;
+	trace_record(timer.op, duration);
+
+	if (trace_path) {
+		uint64_t idx = atomic_fetch_add_explicit(&spans_count, 1, memory_order_relaxed);
+		spans[idx & (TRACE_EVENTS_CAP - 1)] = (TraceSpan){
+			.op = timer.op,
+			.tid = _thread_id(),
+			.start_ms = timer.start_ms,
+			.duration_ms = duration,
+		};
+	}
+
+	return duration;
+}
+
+void trace_record(TraceOp op, double duration_ms) {
+	assert(op >= 0 && op < TRACE_OPS_COUNT);
+
+	uint64_t us = duration_ms > 0 ? (uint64_t)(duration_ms * 1000.0) : 0;
+	TraceHistogram *h = &histograms[op];
+
+	atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&h->total_us, us, memory_order_relaxed);
+	atomic_fetch_add_explicit(&h->buckets[_bucket(us)], 1, memory_order_relaxed);
+
+	uint64_t max = atomic_load_explicit(&h->max_us, memory_order_relaxed);
+	while (us > max) {
+		if (atomic_compare_exchange_weak_explicit(
+			&h->max_us, &max, us,
+			memory_order_relaxed, memory_order_relaxed
+		)) break;
+	}
+}
+
+void trace_dump(void) {
+	// Percentiles are upper bounds of the buckets, so they are precise
+	// up to 2x
+	fprintf(stderr, "TRACE: %-22s %8s %10s %10s %10s %10s %10s\n",
+		"operation", "count", "avg ms", "p50< ms", "p90< ms", "p99< ms", "max ms");
+
+	for (int op = 0; op < TRACE_OPS_COUNT; op++) {
+		const TraceHistogram *h = &histograms[op];
+
+		uint64_t count = atomic_load_explicit(&h->count, memory_order_relaxed);
+		if (count == 0) continue;
+
+		uint64_t total = atomic_load_explicit(&h->total_us, memory_order_relaxed);
+		uint64_t max = atomic_load_explicit(&h->max_us, memory_order_relaxed);
+
+		fprintf(stderr, "TRACE: %-22s %8llu %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+			OP_NAMES[op],
+			(unsigned long long)count,
+			(double)total / (double)count / 1000.0,
+			_percentile(h, count, 50),
+			_percentile(h, count, 90),
+			_percentile(h, count, 99),
+			(double)max / 1000.0
+		);
+	}
+}
+
+void trace_write(void) {
+	if (!trace_path) return;
+
+	FILE *file = fopen(trace_path, "w");
+	if (file == NULL) {
+		TraceLog(LOG_WARNING, "TRACE: Unable to create %s", trace_path);
+		return;
+	}
+
+	uint64_t count = atomic_load(&spans_count);
+	uint64_t first = count > TRACE_EVENTS_CAP ? count - TRACE_EVENTS_CAP : 0;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	bool comma = false;
+	int threads = MIN(atomic_load(&threads_count) + 1, TRACE_MAX_THREADS);
+	for (int tid = 1; tid < threads; tid++) {
+		if (!thread_names[tid]) continue;
+
+		fprintf(file,
+			"%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}\n",
+			comma ? "," : "", tid, thread_names[tid]);
+		comma = true;
+	}
+
+	for (uint64_t i = first; i < count; i++) {
+		const TraceSpan *span = &spans[i & (TRACE_EVENTS_CAP - 1)];
+		fprintf(file,
+			"%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}\n",
+			comma ? "," : "", OP_NAMES[span->op], span->tid,
+			span->start_ms * 1000.0, span->duration_ms * 1000.0);
+		comma = true;
+	}
+
+	fprintf(file, "]}\n");
+
+	if (fclose(file) != 0) {
+		TraceLog(LOG_WARNING, "TRACE: Unable to write %s", trace_path);
+		return;
+	}
+
+	TraceLog(
+		LOG_INFO,
+		"TRACE: Written %llu spans into %s (%llu were overwritten)",
+		(unsigned long long)(count - first),
+		trace_path,
+		(unsigned long long)first
+	);
+
+	free(spans);
+	spans = NULL;
+	trace_path = NULL;
+}
@@ -0,0 +1,86 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Lightweight instrumentation of the operations we care about latency of.
+// Durations are measured with the monotonic clock (see `monotonic_ms()`), so
+// time spent waiting for the network or the GPU is counted too, and are
+// collected into per-operation histograms with power-of-two buckets.
+//
+// If `MUPWIT_TRACE_FILE` environment variable is set, every measured
+// operation is also recorded as a span into a ring buffer, which is written
+// into that file as Chrome trace event JSON on exit (open it in
+// `chrome://tracing` or https://ui.perfetto.dev).
+//
+// Safe to use from any thread.
+
+// Number of histogram buckets, bucket `i` holds durations below `2^i`
+// microseconds (the last one holds everything else)
+#define TRACE_HISTOGRAM_BUCKETS 32
+// Max number of recorded spans, the oldest ones are overwritten
+// Must be a power of two
+#define TRACE_EVENTS_CAP (1 << 18)
+// Max number of threads that can be named with `trace_set_thread_name()`
+#define TRACE_MAX_THREADS 64
+
+typedef enum TraceOp {
+	TRACE_STATUS_FETCH,
+	TRACE_QUEUE_FETCH,
+	TRACE_ALBUMS_FETCH,
+	TRACE_READPICTURE,
+	TRACE_DECODE,
+	TRACE_TEXTURE_UPLOAD,
+	TRACE_FRAME,
+
+	// Single iteration of the client loop, excluding sleeping
+	TRACE_CLIENT_LOOP,
+	TRACE_HANDLE_ACTION,
+	// Waiting for `client_lock_status_nullable()`
+	TRACE_STATUS_LOCK,
+
+	// Sections of a frame
+	TRACE_EVENT_DRAIN,
+	TRACE_DRAW_ALBUMS,
+	TRACE_DRAW_PLAYER,
+	TRACE_DRAW_QUEUE,
+	TRACE_DRAW_CURRENTLY_PLAYING,
+	TRACE_END_DRAWING,
+
+	TRACE_OPS_COUNT,
+} TraceOp;
+
+// Running measurement, see `trace_begin()`
+typedef struct TraceTimer {
+	TraceOp op;
+	double start_ms;
+} TraceTimer;
+
+// Enable spans recording if `MUPWIT_TRACE_FILE` is set
+// Must be called before any other thread is started
+void trace_init(void);
+
+// Name the calling thread in the exported trace
+// `name` must be a static string
+void trace_set_thread_name(const char *name);
+
+// Start measuring the operation
+TraceTimer trace_begin(TraceOp op);
+// Stop measuring, record the duration into the operation histogram and
+// the span into the trace if it is enabled
+// Returns the duration in milliseconds
+double trace_end(TraceTimer timer);
+
+// Record an already measured duration
+void trace_record(TraceOp op, double duration_ms);
+
+// Print statistics of every operation that was recorded at least once to
+// stderr
+void trace_dump(void);
+
+// Write the recorded spans into `MUPWIT_TRACE_FILE`
+// Does nothing if the trace is not enabled
+// Must be called after all the other threads have stopped
+void trace_write(void);
+
+#endif
@@ -1,54 +1,70 @@
 #include "./artwork_image.h"
 #include "./draw.h"
+#include "../artwork_cache.h"
 #include "../macros.h"
 
 ArtworkImage artwork_image_new(void) {
 	return (ArtworkImage){
 		.req_id_nullable = -1,
-		.texture = (Texture){0},
+		.key = 0,
+		.size = 0,
 		.color = (Color){0},
 		.exists = false,
 		.received = false,
 	};
 }
 
-static void _artwork_image_update(ArtworkImage *a, Image image, Color color) {
-	if (image.data) {
-		update_texture_from_image(&a->texture, image);
-		a->color = color;
-		a->exists = true;
-	} else {
-		a->exists = false;
-	}
-}
-
-void artwork_image_on_response_event(ArtworkImage *a, Event event) {
-	if (a->req_id_nullable <= 0 || a->received) return;
+bool artwork_image_on_response_event(ArtworkImage *a, Event event) {
+	if (a->req_id_nullable <= 0 || a->received) return false;
 
 	assert(event.kind == EVENT_RESPONSE);
 	assert(event.data.response_artwork.id > 0);
 	assert(event.data.response_artwork.image.data != NULL);
 
-	if (a->req_id_nullable != event.data.response_artwork.id) return;
-
-	_artwork_image_update(
-		a,
-		event.data.response_artwork.image,
-		event.data.response_artwork.color
-	);
+	if (a->req_id_nullable != event.data.response_artwork.id) return false;
 
+	// Texture was already uploaded into the cache by `state_on_event()`
+	a->key = event.data.response_artwork.key;
+	a->size = event.data.response_artwork.size;
+	a->color = event.data.response_artwork.color;
+	a->exists = true;
 	a->received = true;
 	a->req_id_nullable = -1;
+	return true;
 }
 
-void artwork_image_fetch(ArtworkImage *a, Client *client, const char *song_uri) {
+bool artwork_image_lookup(ArtworkImage *a, TextureCache *cache, uint64_t key, int size) {
+	a->key = key;
+	a->size = artwork_size_class(size);
+
+	const TextureCacheEntry *entry = texture_cache_get(cache, artwork_sized_key(a->key, a->size));
+	if (!entry) return false;
+
+	a->color = entry->color;
+	a->exists = true;
+	a->received = true;
+	return true;
+}
+
+bool artwork_image_fetch(
+	ArtworkImage *a,
+	TextureCache *cache,
+	Client *client,
+	uint64_t key,
+	int size,
+	const char *song_uri,
+	RequestPriority priority
+) {
 	artwork_image_cancel(a, client);
 
-	int id = client_request(client, song_uri);
+	if (artwork_image_lookup(a, cache, key, size)) return true;
+
+	int id = client_request(client, key, a->size, song_uri, priority);
 	a->req_id_nullable = id;
-	if (id <= 0) return;
+	if (id <= 0) return false;
 
 	a->received = false;
+	return false;
 }
 
 void artwork_image_cancel(ArtworkImage *a, Client *client) {
@@ -61,3 +77,15 @@ void artwork_image_cancel(ArtworkImage *a, Client *client) {
 bool artwork_image_is_fetching(const ArtworkImage *a) {
 	return a->req_id_nullable > 0;
 }
+
+const TextureCacheEntry *artwork_image_texture(ArtworkImage *a, TextureCache *cache) {
+	if (!a->exists) return NULL;
+
+	const TextureCacheEntry *entry = texture_cache_get(cache, artwork_sized_key(a->key, a->size));
+	if (entry) return entry;
+
+	// Evicted
+	a->exists = false;
+	a->received = false;
+	return NULL;
+}
@@ -1,14 +1,22 @@
 #ifndef ARTWORK_IMAGE_H
 #define ARTWORK_IMAGE_H
 
+#include <stdint.h>
 #include <raylib.h>
 
+#include "./texture_cache.h"
+
 typedef struct ArtworkImage {
 	// ID of the request
 	// Can be -1
 	int req_id_nullable;
 
-	Texture texture;
+	// Key of the requested artwork (see `artwork_key()`)
+	// The texture itself is owned by the `TextureCache`
+	// 0 - nothing was requested
+	uint64_t key;
+	// Requested mip level (see `artwork_size_class()`)
+	int size;
 	// Average color of the artwork
 	Color color;
 	bool exists;
@@ -21,11 +29,36 @@ typedef struct ArtworkImage {
 
 ArtworkImage artwork_image_new(void);
 
-void artwork_image_on_response_event(ArtworkImage *a, Event event);
+// Returns whether the event is a response to the request of this artwork
+bool artwork_image_on_response_event(ArtworkImage *a, Event event);
 
-void artwork_image_fetch(ArtworkImage *a, Client *client, const char *song_uri);
+// Request artwork identified by `key` (see `artwork_key()`) of the song.
+// `size` is the on-screen size of the artwork in pixels.
+// The texture cache is consulted first, in which case nothing is requested
+// from the client.
+// Returns `true` if the artwork was found in the cache and received immediately
+bool artwork_image_fetch(
+	ArtworkImage *a,
+	TextureCache *cache,
+	Client *client,
+	uint64_t key,
+	int size,
+	const char *song_uri,
+	RequestPriority priority
+);
+// Look the artwork up in the texture cache without requesting it, see
+// `artwork_image_fetch()`
+// Returns `true` if the artwork was found in the cache and received immediately
+bool artwork_image_lookup(ArtworkImage *a, TextureCache *cache, uint64_t key, int size);
 void artwork_image_cancel(ArtworkImage *a, Client *client);
 
 bool artwork_image_is_fetching(const ArtworkImage *a);
 
+// Get texture cache entry of the received artwork and mark it as used in
+// this frame, draw it with `texture_cache_draw()`.
+// Returns `NULL` if there is no artwork.
+// If the texture was evicted from the cache, `received` is reset so the
+// artwork can be fetched again.
+const TextureCacheEntry *artwork_image_texture(ArtworkImage *a, TextureCache *cache);
+
 #endif
@@ -31,12 +31,15 @@ void currently_playing_draw(Context ctx) {
 	const char *title = UNKNOWN;
 	const char *artist_nullable = NULL;
 	enum mpd_state playstate = MPD_STATE_UNKNOWN;
+	unsigned elapsed_ms = 0;
 	unsigned elapsed_sec = 0;
 	unsigned duration_sec = 0;
 
 	if (cur_status_nullable) {
 		playstate = mpd_status_get_state(cur_status_nullable);
-		elapsed_sec = (unsigned)(mpd_status_get_elapsed_ms(cur_status_nullable) / 1000);
+		elapsed_ms = client_elapsed_ms(ctx.client);
+		if (playstate == MPD_STATE_PLAY) request_frame(PLAYBACK_FRAME_MS);
+		elapsed_sec = elapsed_ms / 1000;
 		duration_sec = mpd_status_get_total_time(cur_status_nullable);
 	}
 
@@ -95,12 +98,12 @@ void currently_playing_draw(Context ctx) {
 	// Draw song title
 	offset.y += 2;
 
-	BeginScissorMode(
+	begin_scissor(rect(
 		offset.x,
 		offset.y,
 		right_width,
 		THEME_NORMAL_TEXT_SIZE
-	);
+	));
 
 	Text text = {
 		.text = title,
@@ -123,14 +126,14 @@ void currently_playing_draw(Context ctx) {
 		draw_cropped_text(text, right_width - title_size.x, ctx.state->background);
 	}
 
-	EndScissorMode();
+	end_scissor();
 
 	// Draw progress bar
 	offset.y += ICON_BUTTON_SIZE - PROGRESS_BAR_HEIGHT*2 - 1;
 
 	static ProgressBar bar = {0};
 	bar.rect = rect(offset.x, offset.y, right_width, PROGRESS_BAR_HEIGHT),
-	bar.progress = (float)elapsed_sec / (float)duration_sec,
+	bar.progress = (float)elapsed_ms / (float)(duration_sec * 1000),
 	bar.color = THEME_BLACK,
 
 	progress_bar_draw(&bar, ctx);
@@ -3,6 +3,7 @@
 
 #include "./draw.h"
 #include "../macros.h"
+#include "../utils.h"
 
 #include <GLES3/gl3.h>
 #include <rlgl.h>
@@ -90,6 +91,56 @@ Vec get_mouse_pos(void) {
 	return GetMousePosition();
 }
 
+static double requested_frame_ms = -1;
+static bool frame_resumed = false;
+static bool was_focused = false;
+
+void request_frame(int delay_ms) {
+	double at = monotonic_ms() + delay_ms;
+	if (requested_frame_ms < 0 || at < requested_frame_ms)
+		requested_frame_ms = at;
+}
+
+int take_frame_request(void) {
+	if (requested_frame_ms < 0) return -1;
+
+	int delay_ms = (int)MAX(requested_frame_ms - monotonic_ms(), 0);
+	requested_frame_ms = -1;
+	return delay_ms;
+}
+
+bool input_happened(void) {
+	bool happened = false;
+
+	Vector2 delta = GetMouseDelta();
+	Vector2 wheel = GetMouseWheelMoveV();
+	if (delta.x != 0 || delta.y != 0 || wheel.x != 0 || wheel.y != 0)
+		happened = true;
+
+	for (int button = MOUSE_BUTTON_LEFT; button <= MOUSE_BUTTON_BACK; button++) {
+		if (IsMouseButtonPressed(button) || IsMouseButtonReleased(button))
+			happened = true;
+	}
+
+	// Nothing else uses the key queue, so it can be drained
+	while (GetKeyPressed() != 0) happened = true;
+
+	// Hover depends on the focus (see `get_mouse_pos()`)
+	bool focused = IsWindowFocused();
+	if (focused != was_focused) happened = true;
+	was_focused = focused;
+
+	return happened || IsWindowResized();
+}
+
+void set_frame_resumed(bool resumed) {
+	frame_resumed = resumed;
+}
+
+float frame_time(void) {
+	return frame_resumed ? 0.0 : GetFrameTime();
+}
+
 Rect screen_rect(void) {
 	return (Rect){0, 0, GetScreenWidth(), GetScreenHeight()};
 }
@@ -103,6 +154,53 @@ Rect rect_shrink(Rect rect, float hor, float ver) {
 	};
 }
 
+// Render batch used when the stats are enabled, `NULL` otherwise
+static rlRenderBatch *stats_batch = NULL;
+static DrawStats stats = {0};
+
+// Account draw calls of the render batch that is about to be flushed
+static void _draw_stats_flush(void) {
+	if (!stats_batch) return;
+
+	for (int i = 0; i < stats_batch->drawCounter; i++) {
+		if (stats_batch->draws[i].vertexCount > 0)
+			stats.draw_calls += 1;
+	}
+	stats.flushes += 1;
+}
+
+void begin_scissor(Rect rect) {
+	_draw_stats_flush();
+	BeginScissorMode(rect.x, rect.y, rect.width, rect.height);
+}
+void end_scissor(void) {
+	_draw_stats_flush();
+	EndScissorMode();
+}
+
+void begin_texture_mode(RenderTexture target) {
+	_draw_stats_flush();
+	BeginTextureMode(target);
+}
+void end_texture_mode(void) {
+	_draw_stats_flush();
+	EndTextureMode();
+}
+
+void draw_stats_enable(void) {
+	static rlRenderBatch batch;
+	batch = rlLoadRenderBatch(RL_DEFAULT_BATCH_BUFFERS, RL_DEFAULT_BATCH_BUFFER_ELEMENTS);
+	rlSetRenderBatchActive(&batch);
+	stats_batch = &batch;
+}
+
+DrawStats draw_stats_end_frame(void) {
+	_draw_stats_flush();
+	DrawStats frame = stats;
+	stats = (DrawStats){0};
+	return frame;
+}
+
 char *get_temp_buf(void) {
 #define MAX_BUFFERS 4
 #define BUFFER_CAP 256
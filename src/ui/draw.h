@@ -62,10 +62,60 @@ bool is_shift_down(void);
 
 Vec get_mouse_pos(void);
 
+// Frames are drawn only when something changes (see `main()`), so anything
+// that changes by itself (animations, playback progress) must request
+// the next frame
+// Playback progress is redrawn this often
+#define PLAYBACK_FRAME_MS 100
+
+// Request a frame to be drawn in `delay_ms` milliseconds at the latest
+void request_frame(int delay_ms);
+// Milliseconds until the earliest requested frame
+// Returns -1 if no frame was requested
+// Resets the requests
+int take_frame_request(void);
+// Whether any input happened since the last `PollInputEvents()`
+// Must be called only once per poll
+bool input_happened(void);
+
+// Whether the current frame is the first one after waiting for something to
+// change, time spent waiting is not counted by `frame_time()`
+void set_frame_resumed(bool resumed);
+// Duration of the previous frame in seconds
+// Use it instead of `GetFrameTime()` so animations started on the first
+// frame after waiting are not skipped
+float frame_time(void);
+
 Rect screen_rect(void);
 
 Rect rect_shrink(Rect rect, float hor, float ver);
 
+// Same as `BeginScissorMode()` and `EndScissorMode()`, but the render batch
+// flushes they cause are accounted in `DrawStats`
+void begin_scissor(Rect rect);
+void end_scissor(void);
+// Same for `BeginTextureMode()` and `EndTextureMode()`
+void begin_texture_mode(RenderTexture target);
+void end_texture_mode(void);
+
+typedef struct DrawStats {
+	// Number of draw calls submitted to the GPU
+	int draw_calls;
+	// Number of times the render batch was flushed
+	int flushes;
+} DrawStats;
+
+// Render through a render batch owned by us, so the draw calls can be
+// counted. Only flushes caused by `begin_scissor()`, `end_scissor()`,
+// `begin_texture_mode()`, `end_texture_mode()` and `draw_stats_end_frame()`
+// are accounted, so don't draw anything between raylib's own mode switches
+// when stats are enabled.
+// Must be called after the window is created
+void draw_stats_enable(void);
+// Get the statistics of the current frame and reset them
+// Must be called right before `EndDrawing()`
+DrawStats draw_stats_end_frame(void);
+
 char *get_temp_buf(void);
 
 #define TIME_BUF_LEN 12
@@ -0,0 +1,166 @@
+#include <stdlib.h>
+
+#include <rlgl.h>
+
+#include "./render_cache.h"
+#include "../macros.h"
+
+RenderCache render_cache_new(void) {
+	return (RenderCache){
+		.target = {0},
+		.slot_width = 0,
+		.slot_height = 0,
+
+		.slots = NULL,
+		.slots_count = 0,
+		.slots_used = 0,
+		.used = NULL,
+	};
+}
+
+uint64_t render_cache_key(uint64_t key, uint64_t value) {
+	// splitmix64 finalizer
+	uint64_t z = key + value + 0x9e3779b97f4a7c15ull;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+static void _render_cache_clear(RenderCache *rc) {
+	HASH_CLEAR(hh, rc->used);
+	free(rc->slots);
+	rc->slots = NULL;
+	rc->slots_count = 0;
+	rc->slots_used = 0;
+
+	if (rc->target.id > 0 && IsWindowReady())
+		UnloadRenderTexture(rc->target);
+	rc->target = (RenderTexture){0};
+}
+
+// Split the render texture into slots of the size
+static void _render_cache_resize(RenderCache *rc, int width, int height) {
+	_render_cache_clear(rc);
+
+	rc->slot_width = width;
+	rc->slot_height = height;
+
+	// Wide windows have wide rows
+	int size = RENDER_CACHE_TEXTURE_SIZE;
+	while ((size < width || size < height) && size < RENDER_CACHE_MAX_TEXTURE_SIZE)
+		size *= 2;
+
+	int cols = size / width;
+	int rows = size / height;
+	if (cols <= 0 || rows <= 0) {
+		static bool warned = false;
+		if (!warned) {
+			TraceLog(
+				LOG_WARNING,
+				"RENDER CACHE: %dx%d pieces don't fit into %dx%d render texture, drawing without caching",
+				width,
+				height,
+				size,
+				size
+			);
+			warned = true;
+		}
+		return;
+	}
+
+	rc->target = LoadRenderTexture(size, size);
+	if (rc->target.id == 0) {
+		TraceLog(LOG_WARNING, "RENDER CACHE: Unable to create render texture, drawing without caching");
+		return;
+	}
+
+	rc->slots_count = cols * rows;
+	rc->slots = calloc(rc->slots_count, sizeof(RenderCacheSlot));
+	for (int i = 0; i < rc->slots_count; i++) {
+		rc->slots[i].rect = (Rect){
+			(i % cols) * width,
+			(i / cols) * height,
+			width,
+			height,
+		};
+	}
+}
+
+const RenderCacheSlot *render_cache_get(
+	RenderCache *rc,
+	uint64_t key,
+	int width,
+	int height,
+	unsigned frame,
+	bool *rendered
+) {
+	*rendered = false;
+	if (width <= 0 || height <= 0) return NULL;
+
+	if (width != rc->slot_width || height != rc->slot_height)
+		_render_cache_resize(rc, width, height);
+	if (rc->slots_count == 0) return NULL;
+
+	RenderCacheSlot *slot = NULL;
+	HASH_FIND(hh, rc->used, &key, sizeof(key), slot);
+
+	if (slot) {
+		*rendered = true;
+		HASH_DELETE(hh, rc->used, slot);
+	} else if (rc->slots_used < rc->slots_count) {
+		slot = &rc->slots[rc->slots_used++];
+	} else {
+		// Reuse the least recently used slot, unless it is on the screen
+		slot = rc->used;
+		if (slot->last_used_frame == frame) return NULL;
+		HASH_DELETE(hh, rc->used, slot);
+	}
+
+	// Move slot to the tail so the head is always the least recently used
+	slot->key = key;
+	slot->last_used_frame = frame;
+	HASH_ADD(hh, rc->used, key, sizeof(slot->key), slot);
+
+	return slot;
+}
+
+void render_cache_begin(RenderCache *rc, const RenderCacheSlot *slot, Color background) {
+	begin_texture_mode(rc->target);
+
+	// Keep the slot opaque, otherwise alpha of the antialiased edges is
+	// multiplied by itself and they look thinner when the slot is drawn
+	rlSetBlendFactorsSeparate(
+		RL_SRC_ALPHA, RL_ONE_MINUS_SRC_ALPHA,
+		RL_ONE, RL_ONE_MINUS_SRC_ALPHA,
+		RL_FUNC_ADD, RL_FUNC_ADD
+	);
+	BeginBlendMode(BLEND_CUSTOM_SEPARATE);
+
+	DrawRectangleRec(slot->rect, background);
+}
+
+void render_cache_end(void) {
+	// Slot is flushed with the custom blending still active
+	end_texture_mode();
+	EndBlendMode();
+}
+
+void render_cache_draw(const RenderCache *rc, const RenderCacheSlot *slot, Vec pos) {
+	// Render textures are upside down
+	Rect src = {
+		slot->rect.x,
+		rc->target.texture.height - slot->rect.y - slot->rect.height,
+		slot->rect.width,
+		-slot->rect.height,
+	};
+	Rect dest = {pos.x, pos.y, slot->rect.width, slot->rect.height};
+	DrawTexturePro(rc->target.texture, src, dest, (Vec){0}, 0, WHITE);
+}
+
+void render_cache_free(RenderCache *rc) {
+	// NOTE: render texture is unloaded only if the window (and its GL
+	// context) is still open
+	_render_cache_clear(rc);
+	rc->slot_width = 0;
+	rc->slot_height = 0;
+}
@@ -0,0 +1,80 @@
+#ifndef RENDER_CACHE_H
+#define RENDER_CACHE_H
+
+#include <stdint.h>
+#include <raylib.h>
+
+#include "./draw.h"
+#include "../../thirdparty/uthash.h"
+
+// Width and height of the render texture, it is doubled until the pieces
+// fit into it, but never past the max size
+#define RENDER_CACHE_TEXTURE_SIZE 1024
+#define RENDER_CACHE_MAX_TEXTURE_SIZE 4096
+
+typedef struct RenderCacheSlot {
+	// Key of the prerendered piece, see `render_cache_key()`
+	uint64_t key;
+	// Position of the slot in the render texture (in drawing coordinates)
+	Rect rect;
+	// Number of the frame in which the slot was used the last time
+	unsigned last_used_frame;
+	UT_hash_handle hh; // to make struct hashable
+} RenderCacheSlot;
+
+// Cache of prerendered UI pieces of the same size (list rows, cards, etc...).
+// Pieces are rendered once into the slots of a single render texture, so
+// drawing them again is just a textured quad, and all of them are drawn
+// in one batch.
+// Least recently used slots are reused when there are no free slots left.
+// Must be used only on the main thread.
+typedef struct RenderCache {
+	// Not loaded until the first piece is cached
+	RenderTexture target;
+	int slot_width;
+	int slot_height;
+
+	RenderCacheSlot *slots;
+	int slots_count;
+	// Number of the slots that were ever used
+	int slots_used;
+	// Hash table of the used slots in LRU order (head is the least recently
+	// used)
+	RenderCacheSlot *used;
+} RenderCache;
+
+RenderCache render_cache_new(void);
+
+// Mix the value into the key of a piece, start with 0
+// All the things that affect the look of the piece must be mixed in
+uint64_t render_cache_key(uint64_t key, uint64_t value);
+
+// Find the slot of the piece with `key` and mark it as used in `frame`
+// (see `TextureCache.frame`). All the pieces must be of the same size,
+// otherwise the cache is cleared.
+// Assigns `rendered` to whether the piece is already rendered into the
+// slot, otherwise it must be rendered between `render_cache_begin()` and
+// `render_cache_end()`.
+// Returns `NULL` if the piece can't be cached (it is too large or all the
+// slots are used in this frame), so it must be drawn directly.
+const RenderCacheSlot *render_cache_get(
+	RenderCache *rc,
+	uint64_t key,
+	int width,
+	int height,
+	unsigned frame,
+	bool *rendered
+);
+
+// Start rendering into the slot, drawing coordinates are the same as the
+// texture ones, so the piece must be drawn inside `slot->rect`
+// Slot is cleared with `background`, which must be opaque
+void render_cache_begin(RenderCache *rc, const RenderCacheSlot *slot, Color background);
+void render_cache_end(void);
+
+// Draw the piece from the slot
+void render_cache_draw(const RenderCache *rc, const RenderCacheSlot *slot, Vec pos);
+
+void render_cache_free(RenderCache *rc);
+
+#endif
@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "./text_layout.h"
+#include "../macros.h"
+
+TextLayout text_layout_new(const Font *font, int size, const char *text) {
+	TextLayout layout = {
+		.font = font,
+		.size = size,
+
+		.glyphs = NULL,
+		.offsets = NULL,
+		.len = 0,
+
+		.bounds = {0, size},
+
+		.crop_width = -1,
+		.crop_len = 0,
+	};
+
+	// Text has no more codepoints than bytes, so both arrays are allocated
+	// at once and never grown
+	int cap = strlen(text);
+	if (cap == 0) {
+		layout.bounds.x = 0;
+		return layout;
+	}
+
+	layout.glyphs = malloc(cap * (sizeof(int) + sizeof(float)));
+	if (layout.glyphs == NULL) {
+		TraceLog(LOG_ERROR, "TEXT LAYOUT: Out of memory! (at %s:%d)", __FILE__, __LINE__);
+		abort();
+	}
+	layout.offsets = (float*)(layout.glyphs + cap);
+
+	// Same metrics as `MeasureTextEx()` and `DrawTextEx()` with no spacing
+	float scale = (float)size / font->baseSize;
+	float offset = 0;
+	float width = 0;
+	for (int i = 0; i < cap;) {
+		int codepoint_size = 0;
+		int codepoint = GetCodepointNext(&text[i], &codepoint_size);
+		int index = GetGlyphIndex(*font, codepoint);
+		i += codepoint_size;
+
+		if (codepoint != ' ' && codepoint != '\t') {
+			layout.glyphs[layout.len] = index;
+			layout.offsets[layout.len] = offset;
+			layout.len += 1;
+		}
+
+		if (font->glyphs[index].advanceX != 0) {
+			offset += font->glyphs[index].advanceX * scale;
+			width += font->glyphs[index].advanceX * scale;
+		} else {
+			offset += font->recs[index].width * scale;
+			width += (font->recs[index].width + font->glyphs[index].offsetX) * scale;
+		}
+	}
+	layout.bounds.x = width;
+
+	return layout;
+}
+
+// Draw the glyph cut at `max_x`
+static void _draw_glyph(const Font *font, int index, Vec pos, float scale, float max_x, Color color) {
+	float padding = font->glyphPadding;
+	Rect rec = font->recs[index];
+
+	Rect src = {
+		rec.x - padding,
+		rec.y - padding,
+		rec.width + padding*2,
+		rec.height + padding*2,
+	};
+	Rect dest = {
+		pos.x + (font->glyphs[index].offsetX - padding) * scale,
+		pos.y + (font->glyphs[index].offsetY - padding) * scale,
+		src.width * scale,
+		src.height * scale,
+	};
+
+	if (dest.x >= max_x) return;
+	if (dest.x + dest.width > max_x) {
+		dest.width = max_x - dest.x;
+		src.width = dest.width / scale;
+	}
+
+	DrawTexturePro(font->texture, src, dest, (Vec){0}, 0, color);
+}
+
+static void _draw_glyphs(const TextLayout *layout, int len, Vec pos, float max_x, Color color) {
+	float scale = (float)layout->size / layout->font->baseSize;
+	for (int i = 0; i < len; i++) {
+		Vec glyph_pos = {pos.x + layout->offsets[i], pos.y};
+		_draw_glyph(layout->font, layout->glyphs[i], glyph_pos, scale, max_x, color);
+	}
+}
+
+void draw_text_layout(const TextLayout *layout, Vec pos, Color color) {
+	_draw_glyphs(layout, layout->len, pos, INFINITY, color);
+}
+
+// Number of the glyphs that start before `max_width`
+static int _text_layout_crop(TextLayout *layout, float max_width) {
+	if (layout->crop_width == max_width) return layout->crop_len;
+
+	// Offsets are sorted, so the first glyph past the width is binary searched
+	int lo = 0;
+	int hi = layout->len;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (layout->offsets[mid] < max_width)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	layout->crop_width = max_width;
+	layout->crop_len = lo;
+	return lo;
+}
+
+Vec draw_text_layout_cropped(
+	TextLayout *layout,
+	Vec pos,
+	float max_width,
+	Color color,
+	Color background
+) {
+	if (layout->bounds.x < max_width) {
+		draw_text_layout(layout, pos, color);
+		return layout->bounds;
+	}
+
+	int len = _text_layout_crop(layout, max_width);
+	_draw_glyphs(layout, len, pos, pos.x + max_width, color);
+
+	// Add gradient at the end of the text if it exceeded the container
+	DrawRectangleGradientH(
+		pos.x + max_width - layout->size * 2,
+		pos.y,
+		layout->size * 2,
+		layout->size,
+		ColorAlpha(background, 0.0),
+		background
+	);
+
+	return layout->bounds;
+}
+
+void text_layout_free(TextLayout *layout) {
+	// Offsets are in the same allocation
+	free(layout->glyphs);
+	layout->glyphs = NULL;
+	layout->offsets = NULL;
+	layout->len = 0;
+	layout->crop_width = -1;
+	layout->crop_len = 0;
+}
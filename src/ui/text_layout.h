@@ -0,0 +1,53 @@
+#ifndef TEXT_LAYOUT_H
+#define TEXT_LAYOUT_H
+
+#include <raylib.h>
+
+#include "./draw.h"
+
+// Single line of text with precomputed glyphs and their positions.
+// Text that is drawn every frame (list rows, cards, etc...) is laid out once
+// when it is received, so drawing it doesn't decode UTF-8, look glyphs up in
+// the font or measure the text.
+// Whitespace is not drawn, so it has no glyphs, only advances the following
+// ones.
+typedef struct TextLayout {
+	// Font must outlive the layout (see `Assets`)
+	const Font *font;
+	int size;
+
+	// Indices of the glyphs in the font
+	int *glyphs;
+	// Horizontal offsets of the glyphs from the start of the text in pixels
+	float *offsets;
+	int len;
+
+	// Size of the whole text, same as `measure_text()`
+	Vec bounds;
+
+	// Max width the text was cropped to the last time and number of
+	// the glyphs that start before it, see `draw_text_layout_cropped()`
+	float crop_width;
+	int crop_len;
+} TextLayout;
+
+// Lay out the text, `text` is not referenced by the layout
+TextLayout text_layout_new(const Font *font, int size, const char *text);
+
+// Draw all the glyphs of the text
+void draw_text_layout(const TextLayout *layout, Vec pos, Color color);
+// Same as `draw_cropped_text()`, but the text is clipped at `max_width` by
+// cutting the glyph quads, so it doesn't need a scissor and is drawn in
+// the same batch as everything around it
+// Returns size of the whole text
+Vec draw_text_layout_cropped(
+	TextLayout *layout,
+	Vec pos,
+	float max_width,
+	Color color,
+	Color background
+);
+
+void text_layout_free(TextLayout *layout);
+
+#endif
@@ -0,0 +1,190 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <rlgl.h>
+
+#include "./texture_atlas.h"
+
+#define SLOT_STRIDE(SIZE) ((SIZE) + TEXTURE_ATLAS_PADDING*2)
+
+TextureAtlas texture_atlas_new(void) {
+	return (TextureAtlas){
+		.pages = {0},
+		.free = {{0}},
+	};
+}
+
+// Index of the smallest size class the image fits into
+// Returns -1 if the image is too large
+static int _size_class(int width, int height) {
+	int size = MAX(width, height);
+
+	int class = 0;
+	for (int slot_size = TEXTURE_ATLAS_MIN_SLOT_SIZE; slot_size < size; slot_size *= 2) {
+		class += 1;
+		if (class >= TEXTURE_ATLAS_CLASSES) return -1;
+	}
+	return class;
+}
+
+// Load a page of the size class and put all its slots into the free list
+// Returns `false` if the page texture can't be created
+static bool _texture_atlas_add_page(TextureAtlas *ta, int class) {
+	int slot_size = TEXTURE_ATLAS_MIN_SLOT_SIZE << class;
+	int cols = TEXTURE_ATLAS_PAGE_SIZE / SLOT_STRIDE(slot_size);
+	int size = cols * SLOT_STRIDE(slot_size);
+
+	// Pages are only written through `UpdateTextureRec()`, so their storage
+	// is allocated without any data
+	Texture texture = {
+		.id = rlLoadTexture(NULL, size, size, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, 1),
+		.width = size,
+		.height = size,
+		.mipmaps = 1,
+		.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8,
+	};
+	if (texture.id == 0) {
+		TraceLog(LOG_WARNING, "TEXTURE ATLAS: Unable to create %dx%d page", size, size);
+		return false;
+	}
+	SetTextureFilter(texture, TEXTURE_FILTER_BILINEAR);
+
+	// Reuse an unloaded page, so the indices of the others stay the same
+	int page = -1;
+	for (size_t i = 0; i < ta->pages.len; i++) {
+		if (ta->pages.items[i].texture.id == 0) {
+			page = i;
+			break;
+		}
+	}
+	if (page < 0) {
+		DA_PUSH(&ta->pages, (AtlasPage){0});
+		page = ta->pages.len - 1;
+	}
+
+	ta->pages.items[page] = (AtlasPage){
+		.texture = texture,
+		.slot_size = slot_size,
+		.cols = cols,
+		.slots_used = 0,
+	};
+
+	// Slots are popped from the end, so the page is filled from its start
+	for (int i = cols * cols; i-- > 0;)
+		DA_PUSH(&ta->free[class], ((AtlasSlot){ .page = page, .index = i }));
+
+	return true;
+}
+
+// Copy the image surrounded by its edges extruded by `TEXTURE_ATLAS_PADDING`
+// into a new buffer
+static unsigned char *_extrude(Image image) {
+	int width = image.width + TEXTURE_ATLAS_PADDING*2;
+	int height = image.height + TEXTURE_ATLAS_PADDING*2;
+
+	const unsigned char *src = image.data;
+	unsigned char *dst = malloc((size_t)width * height * 4);
+	if (dst == NULL) return NULL;
+
+	for (int y = 0; y < height; y++) {
+		int src_y = CLAMP(y - TEXTURE_ATLAS_PADDING, 0, image.height - 1);
+		const unsigned char *src_row = src + (size_t)src_y * image.width * 4;
+		unsigned char *dst_row = dst + (size_t)y * width * 4;
+
+		for (int x = 0; x < TEXTURE_ATLAS_PADDING; x++) {
+			memcpy(dst_row + x*4, src_row, 4);
+			memcpy(dst_row + (width - 1 - x)*4, src_row + (image.width - 1)*4, 4);
+		}
+		memcpy(dst_row + TEXTURE_ATLAS_PADDING*4, src_row, (size_t)image.width * 4);
+	}
+
+	return dst;
+}
+
+bool texture_atlas_put(TextureAtlas *ta, Image image, AtlasSlot *slot) {
+	*slot = (AtlasSlot){ .page = -1, .index = 0 };
+
+	if (image.format != PIXELFORMAT_UNCOMPRESSED_R8G8B8A8) return false;
+	if (image.width <= 0 || image.height <= 0) return false;
+
+	int class = _size_class(image.width, image.height);
+	if (class < 0) return false;
+
+	if (ta->free[class].len == 0 && !_texture_atlas_add_page(ta, class))
+		return false;
+
+	unsigned char *pixels = _extrude(image);
+	if (pixels == NULL) return false;
+
+	*slot = ta->free[class].items[--ta->free[class].len];
+	AtlasPage *page = &ta->pages.items[slot->page];
+	page->slots_used += 1;
+
+	Rectangle source = texture_atlas_source(ta, *slot, image.width, image.height);
+	Rectangle padded = {
+		source.x - TEXTURE_ATLAS_PADDING,
+		source.y - TEXTURE_ATLAS_PADDING,
+		source.width + TEXTURE_ATLAS_PADDING*2,
+		source.height + TEXTURE_ATLAS_PADDING*2,
+	};
+	UpdateTextureRec(page->texture, padded, pixels);
+	free(pixels);
+
+	return true;
+}
+
+Texture texture_atlas_texture(const TextureAtlas *ta, AtlasSlot slot) {
+	return ta->pages.items[slot.page].texture;
+}
+
+Rectangle texture_atlas_source(const TextureAtlas *ta, AtlasSlot slot, int width, int height) {
+	const AtlasPage *page = &ta->pages.items[slot.page];
+	int stride = SLOT_STRIDE(page->slot_size);
+
+	return (Rectangle){
+		(slot.index % page->cols) * stride + TEXTURE_ATLAS_PADDING,
+		(slot.index / page->cols) * stride + TEXTURE_ATLAS_PADDING,
+		width,
+		height,
+	};
+}
+
+void texture_atlas_release(TextureAtlas *ta, AtlasSlot slot) {
+	if (slot.page < 0) return;
+
+	AtlasPage *page = &ta->pages.items[slot.page];
+	int class = _size_class(page->slot_size, page->slot_size);
+	assert(class >= 0);
+	assert(page->slots_used > 0);
+
+	page->slots_used -= 1;
+	if (page->slots_used > 0) {
+		DA_PUSH(&ta->free[class], slot);
+		return;
+	}
+
+	// Whole page is free, forget its slots and give the memory back
+	size_t len = 0;
+	for (size_t i = 0; i < ta->free[class].len; i++) {
+		AtlasSlot s = ta->free[class].items[i];
+		if (s.page != slot.page) ta->free[class].items[len++] = s;
+	}
+	ta->free[class].len = len;
+
+	UnloadTexture(page->texture);
+	*page = (AtlasPage){0};
+}
+
+void texture_atlas_free(TextureAtlas *ta) {
+	free(ta->pages.items);
+	ta->pages.items = NULL;
+	ta->pages.len = 0;
+	ta->pages.cap = 0;
+
+	for (int i = 0; i < TEXTURE_ATLAS_CLASSES; i++) {
+		free(ta->free[i].items);
+		ta->free[i].items = NULL;
+		ta->free[i].len = 0;
+		ta->free[i].cap = 0;
+	}
+}
@@ -0,0 +1,72 @@
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include <stdbool.h>
+#include <raylib.h>
+
+#include "../macros.h"
+
+// Images up to this size are packed into atlas pages, the slots are powers
+// of two between these two values, so every artwork mip level (see
+// `ARTWORK_MAX_SIZE`) fits
+#define TEXTURE_ATLAS_MIN_SLOT_SIZE 32
+#define TEXTURE_ATLAS_MAX_SLOT_SIZE 512
+#define TEXTURE_ATLAS_CLASSES 5 // log2(MAX / MIN) + 1
+// Max width and height of a page
+// A page of the largest slots only holds 3x3 of them
+#define TEXTURE_ATLAS_PAGE_SIZE 2048
+// Images are surrounded by this many pixels of their extruded edges, so
+// bilinear filtering doesn't bleed the neighbour slots into them
+#define TEXTURE_ATLAS_PADDING 1
+
+typedef struct AtlasSlot {
+	// Index of the page in `TextureAtlas.pages`
+	// -1 - no slot
+	int page;
+	// Index of the slot in the page
+	int index;
+} AtlasSlot;
+
+typedef struct AtlasPage {
+	// Unloaded (zeroed) if none of the slots are used
+	Texture texture;
+	// Max width and height of the images in the slots (without padding)
+	int slot_size;
+	// Number of slots in a row (and rows in the page)
+	int cols;
+	int slots_used;
+} AtlasPage;
+
+// Packs small images of the same format into a few large textures (pages),
+// so things drawn from them can be batched into a single draw call.
+// Every page is split into slots of one size class, free slots of each
+// class are kept in a free list and pages are unloaded once all their
+// slots are freed.
+// Only `PIXELFORMAT_UNCOMPRESSED_R8G8B8A8` images are supported.
+// Must be used only on the main thread.
+typedef struct TextureAtlas {
+	struct { DA_FIELDS(AtlasPage) } pages;
+	// Free slots of the loaded pages by size class
+	struct { DA_FIELDS(AtlasSlot) } free[TEXTURE_ATLAS_CLASSES];
+} TextureAtlas;
+
+TextureAtlas texture_atlas_new(void);
+
+// Allocate a slot for the image and upload it there
+// Returns `false` if the image is too large or of another format, it must
+// get a texture of its own then
+bool texture_atlas_put(TextureAtlas *ta, Image image, AtlasSlot *slot);
+
+// Texture of the page the slot is in
+Texture texture_atlas_texture(const TextureAtlas *ta, AtlasSlot slot);
+// Region of the page texture the image of `width` and `height` occupies
+// in the slot
+Rectangle texture_atlas_source(const TextureAtlas *ta, AtlasSlot slot, int width, int height);
+
+// Give the slot back, its page is unloaded if it was the last used slot
+void texture_atlas_release(TextureAtlas *ta, AtlasSlot slot);
+
+// NOTE: page textures are not unloaded, same as the rest of `TextureCache`
+void texture_atlas_free(TextureAtlas *ta);
+
+#endif
@@ -0,0 +1,124 @@
+#include "./texture_cache.h"
+#include "./draw.h"
+#include "../macros.h"
+#include "../trace.h"
+
+// NOTE: only the pixels of the artworks count towards the budget, atlas
+// pages are unloaded once all their slots are evicted
+#define ENTRY_BYTES(E) ((size_t)(E)->source.width * (E)->source.height * 4)
+
+TextureCache texture_cache_new(size_t budget_bytes) {
+	return (TextureCache){
+		.entries = NULL,
+		.atlas = texture_atlas_new(),
+		.used_bytes = 0,
+		.budget_bytes = budget_bytes,
+		.frame = 0,
+	};
+}
+
+static bool _entry_in_use(const TextureCache *tc, const TextureCacheEntry *e) {
+	return e->last_used_frame + 1 >= tc->frame;
+}
+
+static void _texture_cache_touch(TextureCache *tc, TextureCacheEntry *e) {
+	e->last_used_frame = tc->frame;
+
+	// Move entry to the tail so the head is always the least recently used
+	HASH_DELETE(hh, tc->entries, e);
+	HASH_ADD(hh, tc->entries, key, sizeof(e->key), e);
+}
+
+// Upload the image into an atlas slot, or into a texture of its own if it
+// doesn't fit into the atlas
+static void _entry_store(TextureCache *tc, TextureCacheEntry *e, Image image) {
+	TraceTimer timer = trace_begin(TRACE_TEXTURE_UPLOAD);
+
+	if (texture_atlas_put(&tc->atlas, image, &e->slot)) {
+		e->texture = texture_atlas_texture(&tc->atlas, e->slot);
+		e->source = texture_atlas_source(&tc->atlas, e->slot, image.width, image.height);
+	} else {
+		e->texture = (Texture){0};
+		update_texture_from_image(&e->texture, image);
+		e->source = (Rectangle){0, 0, image.width, image.height};
+	}
+
+	trace_end(timer);
+	tc->used_bytes += ENTRY_BYTES(e);
+}
+
+static void _entry_release(TextureCache *tc, TextureCacheEntry *e) {
+	tc->used_bytes -= ENTRY_BYTES(e);
+
+	if (e->slot.page >= 0)
+		texture_atlas_release(&tc->atlas, e->slot);
+	else
+		UnloadTexture(e->texture);
+
+	e->texture = (Texture){0};
+	e->slot = (AtlasSlot){ .page = -1, .index = 0 };
+}
+
+static void _texture_cache_evict(TextureCache *tc) {
+	TextureCacheEntry *e, *tmp;
+	HASH_ITER(hh, tc->entries, e, tmp) {
+		if (tc->used_bytes <= tc->budget_bytes) break;
+		// Everything after this entry was used even more recently
+		if (_entry_in_use(tc, e)) break;
+
+		_entry_release(tc, e);
+		HASH_DELETE(hh, tc->entries, e);
+		free(e);
+	}
+}
+
+const TextureCacheEntry *texture_cache_get(TextureCache *tc, uint64_t key) {
+	TextureCacheEntry *e = NULL;
+	HASH_FIND(hh, tc->entries, &key, sizeof(key), e);
+	if (e) _texture_cache_touch(tc, e);
+	return e;
+}
+
+void texture_cache_put(TextureCache *tc, uint64_t key, Image image, Color color) {
+	assert(key != 0);
+	assert(image.data != NULL);
+
+	TextureCacheEntry *e = NULL;
+	HASH_FIND(hh, tc->entries, &key, sizeof(key), e);
+
+	if (e) {
+		_entry_release(tc, e);
+	} else {
+		e = calloc(1, sizeof(TextureCacheEntry));
+		e->key = key;
+		HASH_ADD(hh, tc->entries, key, sizeof(e->key), e);
+	}
+
+	_entry_store(tc, e, image);
+	e->color = color;
+
+	_texture_cache_touch(tc, e);
+	_texture_cache_evict(tc);
+}
+
+void texture_cache_draw(const TextureCacheEntry *e, Rectangle dest, Color tint) {
+	DrawTexturePro(e->texture, e->source, dest, (Vec){0}, 0, tint);
+}
+
+void texture_cache_end_frame(TextureCache *tc) {
+	tc->frame += 1;
+	_texture_cache_evict(tc);
+}
+
+void texture_cache_free(TextureCache *tc) {
+	// NOTE: textures are not unloaded because the cache is freed after the
+	// window (and its GL context) is closed
+	TextureCacheEntry *e, *tmp;
+	HASH_ITER(hh, tc->entries, e, tmp) {
+		HASH_DELETE(hh, tc->entries, e);
+		free(e);
+	}
+	tc->used_bytes = 0;
+
+	texture_atlas_free(&tc->atlas);
+}
@@ -0,0 +1,67 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <raylib.h>
+
+#include "./texture_atlas.h"
+#include "../../thirdparty/uthash.h"
+
+// 64MB of RGBA texels
+#define TEXTURE_CACHE_DEFAULT_BUDGET (64 * 1024 * 1024)
+
+typedef struct TextureCacheEntry {
+	// See `artwork_key()`
+	uint64_t key;
+	// Atlas page the artwork is packed into (shared with other entries), or
+	// a texture of its own if it is too large for the atlas
+	Texture texture;
+	// Region of `texture` occupied by the artwork
+	Rectangle source;
+	// Slot of the artwork in `TextureCache.atlas`, `page` is -1 if the entry
+	// has a texture of its own
+	AtlasSlot slot;
+	// Average color of the artwork
+	Color color;
+	// Number of the frame in which entry was used the last time
+	unsigned last_used_frame;
+	UT_hash_handle hh; // to make struct hashable
+} TextureCacheEntry;
+
+// GPU texture cache of album artworks shared by all pages.
+// Thumbnails are packed into the pages of a texture atlas, so a list of
+// them is drawn with a single texture bind.
+// Entries are kept in least-recently-used order and evicted once the
+// artworks exceed the byte budget, but only if they weren't drawn during
+// the current or the previous frame (i.e. they are off-screen).
+// Must be used only on the main thread.
+typedef struct TextureCache {
+	// Hash table of the entries in LRU order (head is the least recently used)
+	TextureCacheEntry *entries;
+	TextureAtlas atlas;
+	size_t used_bytes;
+	size_t budget_bytes;
+	unsigned frame;
+} TextureCache;
+
+TextureCache texture_cache_new(size_t budget_bytes);
+
+// Find an entry and mark it as used in the current frame
+// Returns `NULL` if there is no such entry
+const TextureCacheEntry *texture_cache_get(TextureCache *tc, uint64_t key);
+
+// Upload image into the cache, replacing the existing entry with the same key
+// Does not take the ownership of the image
+void texture_cache_put(TextureCache *tc, uint64_t key, Image image, Color color);
+
+// Draw the artwork of the entry into `dest`
+void texture_cache_draw(const TextureCacheEntry *e, Rectangle dest, Color tint);
+
+// Advance the frame counter and evict entries if the budget is exceeded
+// Must be called once per frame
+void texture_cache_end_frame(TextureCache *tc);
+
+void texture_cache_free(TextureCache *tc);
+
+#endif
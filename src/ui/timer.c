@@ -1,6 +1,7 @@
 #include <raylib.h>
 
 #include "./timer.h"
+#include "./draw.h"
 #include "../macros.h"
 
 Timer timer_new(unsigned duration_ms, bool looping) {
@@ -14,7 +15,10 @@ Timer timer_new(unsigned duration_ms, bool looping) {
 void timer_update(Timer *t) {
 	if (!timer_playing(t)) return;
 
-	t->elapsed_ms += (unsigned)(GetFrameTime() * 1000);
+	// Draw the next frame of the animation (or its last frame)
+	request_frame(0);
+
+	t->elapsed_ms += (unsigned)(frame_time() * 1000);
 	if (t->looping) {
 		t->elapsed_ms = 0;
 	}
@@ -22,6 +26,7 @@ void timer_update(Timer *t) {
 
 void timer_play(Timer *t) {
 	t->elapsed_ms = 0;
+	request_frame(0);
 }
 
 bool timer_playing(const Timer *t) {
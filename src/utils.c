@@ -1,4 +1,15 @@
+#define _POSIX_C_SOURCE 199309L
+
 #include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "./utils.h"
 #include "./macros.h"
@@ -12,43 +23,294 @@ const char *path_basename(const char *path) {
 		return path;
 }
 
-Color image_average_color(Image image) {
+double monotonic_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+int env_int(const char *name, int fallback) {
+	const char *value = getenv(name);
+	if (!value || value[0] == '\0') return fallback;
+
+	char *end = NULL;
+	long num = strtol(value, &end, 10);
+	if (*end != '\0') {
+		TraceLog(LOG_WARNING, "$%s is not a valid integer (%s), ignoring it", name, value);
+		return fallback;
+	}
+
+	return (int)num;
+}
+
+// Artwork pixels are split into two groups:
+// - saturated (saturation >= 0.5) and not too dark (lightness > 0.3) pixels,
+//   they have the full weight
+// - light (lightness >= 0.6) pixels, they have 1/5 of the weight
+// A pixel can belong to both groups.
+//
+// Lightness and saturation thresholds are checked in integers:
+// - lightness = (max + min) / 510, so lightness > 0.3 is max + min >= 153
+//   (0.3 is rounded up in float) and lightness >= 0.6 is max + min >= 306
+// - saturation = (max - min) / max, so saturation >= 0.5 is
+//   2 * (max - min) >= max
+typedef struct ColorSums {
+	uint64_t sat_r, sat_g, sat_b, sat_n;
+	// Sums of the components divided by 5
+	uint64_t light_r, light_g, light_b, light_n;
+} ColorSums;
+
+#define SAT_LIGHTNESS_MIN 153
+#define LIGHTNESS_MIN 306
+
+static void _color_sums_add_scalar(
+	ColorSums *sums,
+	const unsigned char *data,
+	size_t count,
+	int comps
+) {
+	for (size_t i = 0; i < count * comps; i += comps) {
+		int r = data[i + 0];
+		int g = data[i + 1];
+		int b = data[i + 2];
+		int max = MAX(r, MAX(g, b));
+		int min = MIN(r, MIN(g, b));
+
+		if (max + min >= SAT_LIGHTNESS_MIN && 2 * (max - min) >= max) {
+			sums->sat_r += r;
+			sums->sat_g += g;
+			sums->sat_b += b;
+			sums->sat_n += 1;
+		}
+		if (max + min >= LIGHTNESS_MIN) {
+			sums->light_r += r / 5;
+			sums->light_g += g / 5;
+			sums->light_b += b / 5;
+			sums->light_n += 1;
+		}
+	}
+}
+
+// Max number of pixels accumulated in 32-bit SIMD lanes before they are
+// flushed into `ColorSums`, so lanes never overflow
+#define SIMD_CHUNK (1 << 20)
+// `(x * DIV5_MUL) >> 16 == x / 5` for every x in 0..255
+#define DIV5_MUL 13108
+
+#if defined(__AVX2__)
+
+static void _flush_avx2(uint64_t *sum, __m256i acc) {
+	uint32_t lanes[8];
+	_mm256_storeu_si256((__m256i*)lanes, acc);
+	for (int i = 0; i < 8; i++) *sum += lanes[i];
+}
+
+// Accumulate RGBA pixels, 16 pixels per iteration
+// Returns number of the accumulated pixels, the rest must be accumulated
+// by `_color_sums_add_scalar()`
+static size_t _color_sums_add_simd(ColorSums *sums, const unsigned char *data, size_t count) {
+	const __m256i byte_mask = _mm256_set1_epi32(0xff);
+	const __m256i ones = _mm256_set1_epi16(1);
+	const __m256i div5 = _mm256_set1_epi16(DIV5_MUL);
+	const __m256i sat_lightness_min = _mm256_set1_epi16(SAT_LIGHTNESS_MIN - 1);
+	const __m256i lightness_min = _mm256_set1_epi16(LIGHTNESS_MIN - 1);
+
+	size_t i = 0;
+	while (count - i >= 16) {
+		size_t chunk_end = i + MIN(((count - i) & ~(size_t)15), SIMD_CHUNK);
+
+		__m256i sat_r = _mm256_setzero_si256(), sat_g = sat_r, sat_b = sat_r, sat_n = sat_r;
+		__m256i light_r = sat_r, light_g = sat_r, light_b = sat_r, light_n = sat_r;
+
+		for (; i < chunk_end; i += 16) {
+			__m256i p0 = _mm256_loadu_si256((const __m256i*)(data + i*4));
+			__m256i p1 = _mm256_loadu_si256((const __m256i*)(data + i*4 + 32));
+
+			// Deinterleave into 16-bit lanes, order of the pixels is
+			// shuffled by the pack but it doesn't matter for the sums
+			__m256i r = _mm256_packs_epi32(
+				_mm256_and_si256(p0, byte_mask),
+				_mm256_and_si256(p1, byte_mask)
+			);
+			__m256i g = _mm256_packs_epi32(
+				_mm256_and_si256(_mm256_srli_epi32(p0, 8), byte_mask),
+				_mm256_and_si256(_mm256_srli_epi32(p1, 8), byte_mask)
+			);
+			__m256i b = _mm256_packs_epi32(
+				_mm256_and_si256(_mm256_srli_epi32(p0, 16), byte_mask),
+				_mm256_and_si256(_mm256_srli_epi32(p1, 16), byte_mask)
+			);
+
+			__m256i max = _mm256_max_epi16(r, _mm256_max_epi16(g, b));
+			__m256i min = _mm256_min_epi16(r, _mm256_min_epi16(g, b));
+			__m256i lightness = _mm256_add_epi16(max, min);
+			__m256i chroma = _mm256_sub_epi16(max, min);
+
+			__m256i sat = _mm256_andnot_si256(
+				_mm256_cmpgt_epi16(max, _mm256_add_epi16(chroma, chroma)),
+				_mm256_cmpgt_epi16(lightness, sat_lightness_min)
+			);
+			__m256i light = _mm256_cmpgt_epi16(lightness, lightness_min);
+
+			sat_r = _mm256_add_epi32(sat_r, _mm256_madd_epi16(_mm256_and_si256(r, sat), ones));
+			sat_g = _mm256_add_epi32(sat_g, _mm256_madd_epi16(_mm256_and_si256(g, sat), ones));
+			sat_b = _mm256_add_epi32(sat_b, _mm256_madd_epi16(_mm256_and_si256(b, sat), ones));
+			sat_n = _mm256_add_epi32(sat_n, _mm256_madd_epi16(_mm256_and_si256(ones, sat), ones));
+
+			__m256i r5 = _mm256_mulhi_epu16(r, div5);
+			__m256i g5 = _mm256_mulhi_epu16(g, div5);
+			__m256i b5 = _mm256_mulhi_epu16(b, div5);
+			light_r = _mm256_add_epi32(light_r, _mm256_madd_epi16(_mm256_and_si256(r5, light), ones));
+			light_g = _mm256_add_epi32(light_g, _mm256_madd_epi16(_mm256_and_si256(g5, light), ones));
+			light_b = _mm256_add_epi32(light_b, _mm256_madd_epi16(_mm256_and_si256(b5, light), ones));
+			light_n = _mm256_add_epi32(light_n, _mm256_madd_epi16(_mm256_and_si256(ones, light), ones));
+		}
+
+		_flush_avx2(&sums->sat_r, sat_r);
+		_flush_avx2(&sums->sat_g, sat_g);
+		_flush_avx2(&sums->sat_b, sat_b);
+		_flush_avx2(&sums->sat_n, sat_n);
+		_flush_avx2(&sums->light_r, light_r);
+		_flush_avx2(&sums->light_g, light_g);
+		_flush_avx2(&sums->light_b, light_b);
+		_flush_avx2(&sums->light_n, light_n);
+	}
+
+	return i;
+}
+
+#elif defined(__SSE2__)
+
+static void _flush_sse2(uint64_t *sum, __m128i acc) {
+	uint32_t lanes[4];
+	_mm_storeu_si128((__m128i*)lanes, acc);
+	for (int i = 0; i < 4; i++) *sum += lanes[i];
+}
+
+// Accumulate RGBA pixels, 8 pixels per iteration
+// Returns number of the accumulated pixels, the rest must be accumulated
+// by `_color_sums_add_scalar()`
+static size_t _color_sums_add_simd(ColorSums *sums, const unsigned char *data, size_t count) {
+	const __m128i byte_mask = _mm_set1_epi32(0xff);
+	const __m128i ones = _mm_set1_epi16(1);
+	const __m128i div5 = _mm_set1_epi16(DIV5_MUL);
+	const __m128i sat_lightness_min = _mm_set1_epi16(SAT_LIGHTNESS_MIN - 1);
+	const __m128i lightness_min = _mm_set1_epi16(LIGHTNESS_MIN - 1);
+
+	size_t i = 0;
+	while (count - i >= 8) {
+		size_t chunk_end = i + MIN(((count - i) & ~(size_t)7), SIMD_CHUNK);
+
+		__m128i sat_r = _mm_setzero_si128(), sat_g = sat_r, sat_b = sat_r, sat_n = sat_r;
+		__m128i light_r = sat_r, light_g = sat_r, light_b = sat_r, light_n = sat_r;
+
+		for (; i < chunk_end; i += 8) {
+			__m128i p0 = _mm_loadu_si128((const __m128i*)(data + i*4));
+			__m128i p1 = _mm_loadu_si128((const __m128i*)(data + i*4 + 16));
+
+			// Deinterleave into 16-bit lanes
+			__m128i r = _mm_packs_epi32(
+				_mm_and_si128(p0, byte_mask),
+				_mm_and_si128(p1, byte_mask)
+			);
+			__m128i g = _mm_packs_epi32(
+				_mm_and_si128(_mm_srli_epi32(p0, 8), byte_mask),
+				_mm_and_si128(_mm_srli_epi32(p1, 8), byte_mask)
+			);
+			__m128i b = _mm_packs_epi32(
+				_mm_and_si128(_mm_srli_epi32(p0, 16), byte_mask),
+				_mm_and_si128(_mm_srli_epi32(p1, 16), byte_mask)
+			);
+
+			__m128i max = _mm_max_epi16(r, _mm_max_epi16(g, b));
+			__m128i min = _mm_min_epi16(r, _mm_min_epi16(g, b));
+			__m128i lightness = _mm_add_epi16(max, min);
+			__m128i chroma = _mm_sub_epi16(max, min);
+
+			__m128i sat = _mm_andnot_si128(
+				_mm_cmpgt_epi16(max, _mm_add_epi16(chroma, chroma)),
+				_mm_cmpgt_epi16(lightness, sat_lightness_min)
+			);
+			__m128i light = _mm_cmpgt_epi16(lightness, lightness_min);
+
+			sat_r = _mm_add_epi32(sat_r, _mm_madd_epi16(_mm_and_si128(r, sat), ones));
+			sat_g = _mm_add_epi32(sat_g, _mm_madd_epi16(_mm_and_si128(g, sat), ones));
+			sat_b = _mm_add_epi32(sat_b, _mm_madd_epi16(_mm_and_si128(b, sat), ones));
+			sat_n = _mm_add_epi32(sat_n, _mm_madd_epi16(_mm_and_si128(ones, sat), ones));
+
+			__m128i r5 = _mm_mulhi_epu16(r, div5);
+			__m128i g5 = _mm_mulhi_epu16(g, div5);
+			__m128i b5 = _mm_mulhi_epu16(b, div5);
+			light_r = _mm_add_epi32(light_r, _mm_madd_epi16(_mm_and_si128(r5, light), ones));
+			light_g = _mm_add_epi32(light_g, _mm_madd_epi16(_mm_and_si128(g5, light), ones));
+			light_b = _mm_add_epi32(light_b, _mm_madd_epi16(_mm_and_si128(b5, light), ones));
+			light_n = _mm_add_epi32(light_n, _mm_madd_epi16(_mm_and_si128(ones, light), ones));
+		}
+
+		_flush_sse2(&sums->sat_r, sat_r);
+		_flush_sse2(&sums->sat_g, sat_g);
+		_flush_sse2(&sums->sat_b, sat_b);
+		_flush_sse2(&sums->sat_n, sat_n);
+		_flush_sse2(&sums->light_r, light_r);
+		_flush_sse2(&sums->light_g, light_g);
+		_flush_sse2(&sums->light_b, light_b);
+		_flush_sse2(&sums->light_n, light_n);
+	}
+
+	return i;
+}
+
+#else
+
+static size_t _color_sums_add_simd(ColorSums *sums, const unsigned char *data, size_t count) {
+	(void)sums;
+	(void)data;
+	(void)count;
+	return 0;
+}
+
+#endif
+
+Color image_average_color_sampled(Image image, int row_step) {
 	int comps = 0;
 	if (image.format == PIXELFORMAT_UNCOMPRESSED_R8G8B8)
 		comps = 3;
 	else if (image.format == PIXELFORMAT_UNCOMPRESSED_R8G8B8A8)
 		comps = 4;
 
+	if (row_step < 1) row_step = 1;
+
 	// Calculate average color of the artwork
 	Color color = {0};
 	if (comps > 0) {
-		unsigned char *data = image.data;
-		float cr = 0.0, cg = 0.0, cb = 0.0;
-		float n = 1.0;
-		for (int i = 0; i < image.width * image.height * comps; i += comps) {
-			int r = data[i + 0];
-			int g = data[i + 1];
-			int b = data[i + 2];
-			float max = (float)MAX(r, MAX(g, b));
-			float min = (float)MIN(r, MIN(g, b));
-			float saturation = 0.0;
-			float lightness = (max + min) / 2.0 / 255.0;
-			if (max > 0) saturation = (max - min) / max;
-
-			if (saturation >= 0.5 && lightness > 0.3) {
-				n += 1.0;
-				cr += r;
-				cg += g;
-				cb += b;
-			}
-			if (lightness >= 0.6) {
-				n += 0.2;
-				cr += r/5;
-				cg += g/5;
-				cb += b/5;
-			}
+		const unsigned char *data = image.data;
+		size_t row_size = (size_t)image.width * comps;
+		ColorSums sums = {0};
+
+		// Rows are contiguous, so every row is accumulated as a whole
+		// If every row is sampled, the whole image is one long row
+		size_t rows = image.height;
+		size_t row_width = image.width;
+		if (row_step == 1) {
+			row_width *= rows;
+			rows = 1;
+		}
+
+		for (size_t y = 0; y < rows; y += row_step) {
+			const unsigned char *row = data + y * row_size;
+
+			size_t done = 0;
+			if (comps == 4)
+				done = _color_sums_add_simd(&sums, row, row_width);
+
+			_color_sums_add_scalar(&sums, row + done * comps, row_width - done, comps);
 		}
 
+		float n = 1.0 + sums.sat_n + sums.light_n * 0.2;
+		float cr = sums.sat_r + sums.light_r;
+		float cg = sums.sat_g + sums.light_g;
+		float cb = sums.sat_b + sums.light_b;
+
 		color = (Color){
 			(char)MAX(cr/n, 50.0),
 			(char)MAX(cg/n, 50.0),
@@ -59,3 +321,22 @@ Color image_average_color(Image image) {
 
 	return ColorBrightness(color, 0.4);
 }
+
+Color image_average_color(Image image) {
+	return image_average_color_sampled(image, 1);
+}
+
+void image_fit(Image *image, int max_size) {
+	if (image->width <= max_size && image->height <= max_size) return;
+
+	int width, height;
+	if (image->width >= image->height) {
+		width = max_size;
+		height = MAX(image->height * max_size / image->width, 1);
+	} else {
+		width = MAX(image->width * max_size / image->height, 1);
+		height = max_size;
+	}
+
+	ImageResize(image, width, height);
+}
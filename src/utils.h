@@ -6,6 +6,25 @@
 // Get basename of the path (part after the last '/')
 const char *path_basename(const char *path);
 
+// Milliseconds since some unspecified point, never goes backwards
+// Unlike `clock()` it also counts the time spent waiting for IO
+double monotonic_ms(void);
+
+// Read integer from the environment variable
+// Returns `fallback` if variable is not set or is not a valid integer
+int env_int(const char *name, int fallback);
+
+// Weighted average color of the saturated and light pixels of the image
+// Only `PIXELFORMAT_UNCOMPRESSED_R8G8B8(A8)` images are supported, black is
+// returned for other formats.
+// Vectorized with AVX2 or SSE2 when available.
 Color image_average_color(Image image);
+// Same as `image_average_color()`, but only every `row_step`-th row of the
+// image is sampled
+Color image_average_color_sampled(Image image, int row_step);
+
+// Downscale image (keeping aspect ratio) so neither of its sides is larger
+// than `max_size`. Does nothing if image is already small enough.
+void image_fit(Image *image, int max_size);
 
 #endif